@@ -57,6 +57,14 @@ func _ready() -> void:
 	#instantiated_connection()
 	#test_prepared_select()
 	#test_prepared_cmd()
+	#test_reset_vs_reconnect(100)
+	#test_connect_latency(100)
+	#test_ed25519_signing(2000)
+	#test_galera_pool([3306, 3307, 3308], 20)
+	#test_pool_warm_up(32)
+	#test_run_parallel(6)
+	#test_scan_ranges(8)
+	#test_query_deadline(500)
 	test_varbinary()
 	
 
@@ -174,6 +182,232 @@ func test_varbinary() -> void:
 		printerr("Error %d on select" % [ctx_db.last_error])
 
 
+func test_reset_vs_reconnect(p_iterations: int) -> void:
+	var ctx := MariaDBConnectContext.new()
+	ctx.hostname = ed["db_hostname"] as String
+	ctx.port = ed["db_port"]
+	ctx.db_name = ed["db_name"] as String
+	ctx.username = ed["db_ed_user"] as String
+	ctx.password = ed["db_sha512_hashed_pwd_b64"] as String
+	
+	var ctx_db := MariaDBConnector.new()
+	if ctx_db.connect_db_ctx(ctx) != MariaDBConnector.ErrorCode.OK:
+		printerr("Error %d on connect" % [ctx_db.last_error])
+		return
+	
+	var start_uticks := Time.get_ticks_usec()
+	for i in p_iterations:
+		if ctx_db.reset_session() != MariaDBConnector.ErrorCode.OK:
+			printerr("Error %d on reset_session" % [ctx_db.last_error])
+			return
+	var reset_usec: float = float(Time.get_ticks_usec() - start_uticks) / p_iterations
+	
+	start_uticks = Time.get_ticks_usec()
+	for i in p_iterations:
+		ctx_db.disconnect_db()
+		if ctx_db.connect_db_ctx(ctx) != MariaDBConnector.ErrorCode.OK:
+			printerr("Error %d on reconnect" % [ctx_db.last_error])
+			return
+	var reconnect_usec: float = float(Time.get_ticks_usec() - start_uticks) / p_iterations
+	
+	print("reset_session avg: %.1f usec, disconnect + connect avg: %.1f usec" % [reset_usec, reconnect_usec])
+	ctx_db.disconnect_db()
+
+
+func test_connect_latency(p_iterations: int) -> void:
+	var ctxs: Array[MariaDBConnectContext] = []
+	for auth_type in [MariaDBConnectContext.AUTH_TYPE_ED25519, MariaDBConnectContext.AUTH_TYPE_MYSQL_NATIVE]:
+		var ctx := MariaDBConnectContext.new()
+		ctx.hostname = ed["db_hostname"] as String
+		ctx.port = ed["db_port"]
+		ctx.db_name = ed["db_name"] as String
+		ctx.auth_type = auth_type
+		if auth_type == MariaDBConnectContext.AUTH_TYPE_ED25519:
+			ctx.username = ed["db_ed_user"] as String
+			ctx.password = ed["db_sha512_hashed_pwd_b64"] as String
+		else:
+			ctx.username = ed["db_native_user"] as String
+			ctx.password = ed["db_sha1_hashed_pwd_b64"] as String
+		ctxs.append(ctx)
+	
+	var ctx_db := MariaDBConnector.new()
+	for ctx in ctxs:
+		var total_usec: int = 0
+		var stats: Dictionary
+		for i in p_iterations:
+			if ctx_db.connect_db_ctx(ctx) != MariaDBConnector.ErrorCode.OK:
+				printerr("Error %d on connect" % [ctx_db.last_error])
+				return
+			stats = ctx_db.get_connect_stats()
+			total_usec += stats["usec"]
+			ctx_db.disconnect_db()
+		print("%s: %d round trips, connect avg: %.1f usec" %
+				[stats["auth_plugin"], stats["round_trips"], float(total_usec) / p_iterations])
+
+
+# Client side cost of a client_ed25519 login, no server needed
+func test_ed25519_signing(p_iterations: int) -> void:
+	var pw_hash: PackedByteArray = (ed["db_sha512_hashed_pwd"] as String).hex_decode()
+	var nonce := PackedByteArray()
+	nonce.resize(32)
+	var sig: PackedByteArray
+	var start_uticks := Time.get_ticks_usec()
+	for i in p_iterations:
+		nonce.encode_u32(0, i)
+		sig = db.get_client_ed25519_signature(pw_hash, nonce)
+	var elapsed_usec: int = Time.get_ticks_usec() - start_uticks
+	print("ed25519 %s: %.0f signatures/sec, %.1f usec each" %
+			[MariaDBConnector.get_ed25519_backend(), p_iterations * 1000000.0 / elapsed_usec,
+			float(elapsed_usec) / p_iterations])
+
+
+# Three local mariadbd instances forming a Galera cluster, desync one with
+# SET GLOBAL wsrep_desync = ON while this runs to watch it leave the pool.
+func test_galera_pool(p_ports: Array, p_seconds: int) -> void:
+	var pool := MariaDBConnectionPool.new()
+	for port in p_ports:
+		var ctx := MariaDBConnectContext.new()
+		ctx.hostname = ed["db_hostname"] as String
+		ctx.port = port
+		ctx.db_name = ed["db_name"] as String
+		ctx.username = ed["db_ed_user"] as String
+		ctx.password = ed["db_sha512_hashed_pwd_b64"] as String
+		pool.add_node(ctx)
+	pool.pin_writes = true
+	pool.start_monitor(500)
+	
+	for i in p_seconds:
+		await get_tree().create_timer(1.0).timeout
+		# @@port is not replica safe, it runs as a write on the pinned node
+		var rows := pool.select_query("SELECT @@port AS port")
+		print("writer node %d on port %s" % [pool.get_writer_node(),
+				rows[0]["port"] if not rows.is_empty() else "none"])
+		for status in pool.get_node_status():
+			print("  %s state %d ready %s usable %s" % [status["hostname"], status["wsrep_local_state"],
+					status["wsrep_ready"], status["usable"]])
+	pool.close()
+
+
+# Sequential connects against a concurrent pool warm-up of the same size
+func test_pool_warm_up(p_size: int) -> void:
+	var ctx := MariaDBConnectContext.new()
+	ctx.hostname = ed["db_hostname"] as String
+	ctx.port = ed["db_port"]
+	ctx.db_name = ed["db_name"] as String
+	ctx.username = ed["db_ed_user"] as String
+	ctx.password = ed["db_sha512_hashed_pwd_b64"] as String
+	
+	var conns: Array[MariaDBConnector] = []
+	var start_uticks := Time.get_ticks_usec()
+	for i in p_size:
+		var conn := MariaDBConnector.new()
+		if conn.connect_db_ctx(ctx) != MariaDBConnector.ErrorCode.OK:
+			printerr("Error %d on connect" % [conn.last_error])
+			return
+		conns.append(conn)
+	print("%d sequential connects: %d msec" % [p_size, (Time.get_ticks_usec() - start_uticks) / 1000])
+	for conn in conns:
+		conn.disconnect_db()
+	
+	var pool := MariaDBConnectionPool.new()
+	pool.add_node(ctx)
+	pool.max_size = p_size
+	pool.warm_up()
+	var result: Array = await pool.warmed_up
+	print("pool warm-up: %d opened, %d failed in %d msec" % result)
+	pool.close()
+
+
+# The same independent SELECTs one after another on a single connection and spread over a pool
+func test_run_parallel(p_count: int) -> void:
+	var ctx := MariaDBConnectContext.new()
+	ctx.hostname = ed["db_hostname"] as String
+	ctx.port = ed["db_port"]
+	ctx.db_name = ed["db_name"] as String
+	ctx.username = ed["db_ed_user"] as String
+	ctx.password = ed["db_sha512_hashed_pwd_b64"] as String
+	
+	var stmts: Array = []
+	for i in p_count:
+		stmts.append("SELECT %d AS n, SLEEP(0.05) AS s" % i)
+	
+	var conn := MariaDBConnector.new()
+	if conn.connect_db_ctx(ctx) != MariaDBConnector.ErrorCode.OK:
+		printerr("Error %d on connect" % [conn.last_error])
+		return
+	var start_uticks := Time.get_ticks_usec()
+	for stmt in stmts:
+		conn.select_query(stmt)
+	print("%d sequential selects: %d msec" % [p_count, (Time.get_ticks_usec() - start_uticks) / 1000])
+	conn.disconnect_db()
+	
+	var pool := MariaDBConnectionPool.new()
+	pool.add_node(ctx)
+	pool.max_size = p_count
+	pool.warm_up()
+	await pool.warmed_up
+	start_uticks = Time.get_ticks_usec()
+	var results := pool.run_parallel(stmts)
+	print("%d parallel selects: %d msec, error %d" % [results.size(), (Time.get_ticks_usec() - start_uticks) / 1000,
+			pool.get_last_error()])
+	pool.close()
+
+
+# Full export of many_records on one connection against a range scan over p_connections
+func test_scan_ranges(p_connections: int) -> void:
+	var ctx := MariaDBConnectContext.new()
+	ctx.hostname = ed["db_hostname"] as String
+	ctx.port = ed["db_port"]
+	ctx.db_name = ed["db_name"] as String
+	ctx.username = ed["db_ed_user"] as String
+	ctx.password = ed["db_sha512_hashed_pwd_b64"] as String
+	
+	var conn := MariaDBConnector.new()
+	if conn.connect_db_ctx(ctx) != MariaDBConnector.ErrorCode.OK:
+		printerr("Error %d on connect" % [conn.last_error])
+		return
+	var start_uticks := Time.get_ticks_usec()
+	var rows := conn.select_query("SELECT * FROM many_records")
+	print("single connection: %d rows in %d msec" % [rows.size(), (Time.get_ticks_usec() - start_uticks) / 1000])
+	conn.disconnect_db()
+	
+	var pool := MariaDBConnectionPool.new()
+	pool.add_node(ctx)
+	pool.max_size = p_connections
+	pool.warm_up()
+	await pool.warmed_up
+	var scanned := [0]
+	start_uticks = Time.get_ticks_usec()
+	var err := pool.scan_ranges("many_records", "id", func(chunk: Array, _range: int) -> void:
+		scanned[0] += chunk.size())
+	print("%d ranges: %d rows in %d msec, error %d" % [p_connections, scanned[0],
+			(Time.get_ticks_usec() - start_uticks) / 1000, err])
+	pool.close()
+
+
+# A statement running past its deadline is stopped on the server and the connection keeps working
+func test_query_deadline(p_deadline_msec: int) -> void:
+	var ctx := MariaDBConnectContext.new()
+	ctx.hostname = ed["db_hostname"] as String
+	ctx.port = ed["db_port"]
+	ctx.db_name = ed["db_name"] as String
+	ctx.username = ed["db_ed_user"] as String
+	ctx.password = ed["db_sha512_hashed_pwd_b64"] as String
+	
+	var conn := MariaDBConnector.new()
+	if conn.connect_db_ctx(ctx) != MariaDBConnector.ErrorCode.OK:
+		printerr("Error %d on connect" % [conn.last_error])
+		return
+	var start_uticks := Time.get_ticks_usec()
+	conn.select_query("SELECT SLEEP(10) AS s", p_deadline_msec)
+	print("deadline %d msec: error %d after %d msec" % [p_deadline_msec, conn.last_error,
+			(Time.get_ticks_usec() - start_uticks) / 1000])
+	var rows := conn.select_query("SELECT CONNECTION_ID() AS id")
+	print("same session %s, error %d" % [not rows.is_empty() and rows[0]["id"] == conn.get_connection_id(),
+			conn.last_error])
+	conn.disconnect_db()
+
+
 func context_connection() -> void:
 	var ctx := MariaDBConnectContext.new()
 	ctx.hostname = ed["db_hostname"] as String
@@ -29,6 +29,11 @@
 /* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
 /*************************************************************************/
 #include "mariadb_connect_context.hpp"
+#include "mariadb_dns_cache.hpp"
+
+#include <godot_cpp/classes/marshalls.hpp>
+
+MariaDBConnectContext::MariaDBConnectContext() { _cred_mutex.instantiate(); }
 
 void MariaDBConnectContext::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("set_hostname", "hostname"), &MariaDBConnectContext::set_hostname);
@@ -39,6 +44,8 @@ void MariaDBConnectContext::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("set_auth_type", "auth_type"), &MariaDBConnectContext::set_auth_type);
 	ClassDB::bind_method(D_METHOD("set_encoding", "encoding"), &MariaDBConnectContext::set_encoding);
 	ClassDB::bind_method(D_METHOD("set_is_prehashed", "is_prehashed"), &MariaDBConnectContext::set_is_prehashed);
+	ClassDB::bind_method(
+			D_METHOD("set_init_statements", "statements"), &MariaDBConnectContext::set_init_statements);
 
 	ClassDB::bind_method(D_METHOD("get_hostname"), &MariaDBConnectContext::get_hostname);
 	ClassDB::bind_method(D_METHOD("get_port"), &MariaDBConnectContext::get_port);
@@ -48,6 +55,17 @@ void MariaDBConnectContext::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("get_auth_type"), &MariaDBConnectContext::get_auth_type);
 	ClassDB::bind_method(D_METHOD("get_encoding"), &MariaDBConnectContext::get_encoding);
 	ClassDB::bind_method(D_METHOD("get_is_prehashed"), &MariaDBConnectContext::get_is_prehashed);
+	ClassDB::bind_method(D_METHOD("get_init_statements"), &MariaDBConnectContext::get_init_statements);
+
+	ClassDB::bind_method(D_METHOD("set_hosts", "hosts"), &MariaDBConnectContext::set_hosts);
+	ClassDB::bind_method(D_METHOD("get_hosts"), &MariaDBConnectContext::get_hosts);
+	ClassDB::bind_method(D_METHOD("set_connect_strategy", "strategy"), &MariaDBConnectContext::set_connect_strategy);
+	ClassDB::bind_method(D_METHOD("get_connect_strategy"), &MariaDBConnectContext::get_connect_strategy);
+	ClassDB::bind_method(
+			D_METHOD("set_connect_timeout_msec", "msec"), &MariaDBConnectContext::set_connect_timeout_msec);
+	ClassDB::bind_method(D_METHOD("get_connect_timeout_msec"), &MariaDBConnectContext::get_connect_timeout_msec);
+	ClassDB::bind_method(D_METHOD("set_race_delay_msec", "msec"), &MariaDBConnectContext::set_race_delay_msec);
+	ClassDB::bind_method(D_METHOD("get_race_delay_msec"), &MariaDBConnectContext::get_race_delay_msec);
 
 	ADD_PROPERTY(PropertyInfo(Variant::STRING, "hostname"), "set_hostname", "get_hostname");
 	ADD_PROPERTY(PropertyInfo(Variant::INT, "port"), "set_port", "get_port");
@@ -57,6 +75,14 @@ void MariaDBConnectContext::_bind_methods() {
 	ADD_PROPERTY(PropertyInfo(Variant::INT, "auth_type"), "set_auth_type", "get_auth_type");
 	ADD_PROPERTY(PropertyInfo(Variant::INT, "encoding"), "set_encoding", "get_encoding");
 	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "is_prehashed"), "set_is_prehashed", "get_is_prehashed");
+	ADD_PROPERTY(PropertyInfo(Variant::PACKED_STRING_ARRAY, "init_statements"),
+			"set_init_statements",
+			"get_init_statements");
+	ADD_PROPERTY(PropertyInfo(Variant::PACKED_STRING_ARRAY, "hosts"), "set_hosts", "get_hosts");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "connect_strategy"), "set_connect_strategy", "get_connect_strategy");
+	ADD_PROPERTY(
+			PropertyInfo(Variant::INT, "connect_timeout_msec"), "set_connect_timeout_msec", "get_connect_timeout_msec");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "race_delay_msec"), "set_race_delay_msec", "get_race_delay_msec");
 
 	BIND_ENUM_CONSTANT(ENCODE_BASE64);
 	BIND_ENUM_CONSTANT(ENCODE_HEX);
@@ -64,4 +90,82 @@ void MariaDBConnectContext::_bind_methods() {
 
 	BIND_ENUM_CONSTANT(AUTH_TYPE_ED25519);
 	BIND_ENUM_CONSTANT(AUTH_TYPE_MYSQL_NATIVE);
+	BIND_ENUM_CONSTANT(AUTH_TYPE_CACHING_SHA2);
+
+	BIND_ENUM_CONSTANT(CONNECT_ORDERED);
+	BIND_ENUM_CONSTANT(CONNECT_RANDOM);
+	BIND_ENUM_CONSTANT(CONNECT_RACE);
+}
+
+void MariaDBConnectContext::get_endpoints(PackedStringArray &r_hosts, PackedInt32Array &r_ports) const {
+	r_hosts.clear();
+	r_ports.clear();
+	if (_hosts.is_empty()) {
+		r_hosts.push_back(_hostname);
+		r_ports.push_back(_port);
+		return;
+	}
+
+	for (const String &entry : _hosts) {
+		String host = entry.strip_edges();
+		int port = _port;
+		if (host.begins_with("[")) {
+			// [ipv6] or [ipv6]:port
+			const int close = host.find("]");
+			if (close < 0) continue;
+			if (host.substr(close + 1).begins_with(":")) port = host.substr(close + 2).to_int();
+			host = host.substr(1, close - 1);
+		} else if (host.count(":") == 1) {
+			port = host.get_slice(":", 1).to_int();
+			host = host.get_slice(":", 0);
+		}
+		// More than one colon without brackets is a bare IPv6 address
+		if (host.is_empty()) continue;
+		r_hosts.push_back(host);
+		r_ports.push_back(port);
+	}
+}
+
+String MariaDBConnectContext::get_connect_password() const {
+	if (_encoding == ENCODE_BASE64) {
+		// BASE64 should always be treated as binary -> hex
+		return Marshalls::get_singleton()->base64_to_raw(_password).hex_encode();
+	} else if (_is_prehashed && _encoding == ENCODE_PLAIN) {
+		return _password.to_utf8_buffer().hex_encode();
+	}
+	// hex decode is dangerous, just pass the unmodified string if hex or plain
+	return _password;
+}
+
+Ed25519CredentialPtr MariaDBConnectContext::get_ed25519_credential() {
+	if (_auth_type != AUTH_TYPE_ED25519) return nullptr;
+
+	_cred_mutex->lock();
+	if (!_ed25519_cred) {
+		String password = get_connect_password();
+		PackedByteArray pw_sha512;
+		if (password.length() > 0) {
+			pw_sha512 = _is_prehashed ? password.hex_decode() : Ed25519Credential::hash_password(password);
+		}
+		// A malformed prehash is left to the connector to report
+		_ed25519_cred = Ed25519Credential::create(pw_sha512);
+		pw_sha512.fill(0);
+	}
+	Ed25519CredentialPtr cred = _ed25519_cred;
+	_cred_mutex->unlock();
+	return cred;
+}
+
+void MariaDBConnectContext::_prefetch_endpoints() const {
+	PackedStringArray hosts;
+	PackedInt32Array ports;
+	get_endpoints(hosts, ports);
+	for (const String &host : hosts) MariaDBDnsCache::prefetch(host, IP::TYPE_ANY);
+}
+
+void MariaDBConnectContext::_reset_ed25519_credential() {
+	if (_cred_mutex.is_null()) return;
+	_cred_mutex->lock();
+	_ed25519_cred.reset();
+	_cred_mutex->unlock();
 }
@@ -31,10 +31,14 @@
 #pragma once
 
 #include "mariadb_connector_common.hpp"
+#include "mariadb_ed25519_credential.hpp"
 
+#include <godot_cpp/classes/mutex.hpp>
 #include <godot_cpp/classes/ref_counted.hpp>
 #include <godot_cpp/core/class_db.hpp>
 
+#include <memory>
+
 using namespace godot;
 // using MariaDBConnector_AuthType = MariaDBConnector::AuthType;
 
@@ -45,18 +49,45 @@ public:
 	enum AuthType {
 		AUTH_TYPE_ED25519 = MariaDBConnectorCommon::AUTH_TYPE_ED25519,
 		AUTH_TYPE_MYSQL_NATIVE = MariaDBConnectorCommon::AUTH_TYPE_MYSQL_NATIVE,
+		AUTH_TYPE_CACHING_SHA2 = MariaDBConnectorCommon::AUTH_TYPE_CACHING_SHA2,
 		AUTH_TYPE_LAST = MariaDBConnectorCommon::AUTH_TYPE_LAST
 	};
 	enum Encoding { ENCODE_BASE64, ENCODE_HEX, ENCODE_PLAIN };
+	enum ConnectStrategy { CONNECT_ORDERED, CONNECT_RANDOM, CONNECT_RACE };
+
+	MariaDBConnectContext();
 
-	void set_hostname(const String &p_hostname) { _hostname = p_hostname; }
+	void set_hostname(const String &p_hostname) {
+		_hostname = p_hostname;
+		_prefetch_endpoints();
+	}
 	void set_port(int p_port) { _port = p_port; }
 	void set_db_name(const String &p_db_name) { _db_name = p_db_name; }
 	void set_username(const String &p_username) { _username = p_username; }
-	void set_password(const String &p_password) { _password = p_password; }
-	void set_auth_type(AuthType p_auth_type) { _auth_type = p_auth_type; }
-	void set_encoding(Encoding p_encoding) { _encoding = p_encoding; }
-	void set_is_prehashed(bool p_is_prehashed) { _is_prehashed = p_is_prehashed; }
+	void set_password(const String &p_password) {
+		_password = p_password;
+		_reset_ed25519_credential();
+	}
+	void set_auth_type(AuthType p_auth_type) {
+		_auth_type = p_auth_type;
+		_reset_ed25519_credential();
+	}
+	void set_encoding(Encoding p_encoding) {
+		_encoding = p_encoding;
+		_reset_ed25519_credential();
+	}
+	void set_is_prehashed(bool p_is_prehashed) {
+		_is_prehashed = p_is_prehashed;
+		_reset_ed25519_credential();
+	}
+	void set_init_statements(const PackedStringArray &p_statements) { _init_statements = p_statements; }
+	void set_hosts(const PackedStringArray &p_hosts) {
+		_hosts = p_hosts;
+		_prefetch_endpoints();
+	}
+	void set_connect_strategy(ConnectStrategy p_strategy) { _connect_strategy = p_strategy; }
+	void set_connect_timeout_msec(int p_msec) { _connect_timeout_msec = p_msec; }
+	void set_race_delay_msec(int p_msec) { _race_delay_msec = p_msec; }
 
 	String get_hostname() const { return _hostname; }
 	int get_port() const { return _port; }
@@ -66,11 +97,37 @@ public:
 	AuthType get_auth_type() const { return _auth_type; }
 	Encoding get_encoding() const { return _encoding; }
 	bool get_is_prehashed() const { return _is_prehashed; }
+	PackedStringArray get_init_statements() const { return _init_statements; }
+	PackedStringArray get_hosts() const { return _hosts; }
+	ConnectStrategy get_connect_strategy() const { return _connect_strategy; }
+	int get_connect_timeout_msec() const { return _connect_timeout_msec; }
+	int get_race_delay_msec() const { return _race_delay_msec; }
+
+	/**
+	 * \brief		Candidate endpoints in listed order, the hosts entries as "host", "host:port" or "[ipv6]:port"
+	 *				with port as the default, or hostname and port alone when hosts is empty.
+	 */
+	void get_endpoints(PackedStringArray &r_hosts, PackedInt32Array &r_ports) const;
+
+	/**
+	 * \brief		The password in the form MariaDBConnector::connect_db expects, base64 is decoded to hex and a
+	 *				plain prehash is converted to hex, otherwise the password is passed unmodified.
+	 */
+	String get_connect_password() const;
+	/**
+	 * \brief		client_ed25519 key material derived on first use and shared by every connection made with this
+	 *				context, null when the auth type is not ED25519 or the password can't form a key.
+	 */
+	Ed25519CredentialPtr get_ed25519_credential();
 
 protected:
 	static void _bind_methods();
 
 private:
+	void _reset_ed25519_credential();
+	// Starts resolving the hostnames in the background so the first connect finds them cached
+	void _prefetch_endpoints() const;
+
 	String _hostname = "127.0.0.1";
 	int _port = 3306;
 	String _db_name;
@@ -79,7 +136,16 @@ private:
 	AuthType _auth_type = AuthType::AUTH_TYPE_ED25519;
 	Encoding _encoding = ENCODE_BASE64;
 	bool _is_prehashed = true;
+	PackedStringArray _init_statements;
+	PackedStringArray _hosts;
+	ConnectStrategy _connect_strategy = CONNECT_ORDERED;
+	int _connect_timeout_msec = 1000;
+	int _race_delay_msec = 50;
+
+	Ref<Mutex> _cred_mutex;
+	Ed25519CredentialPtr _ed25519_cred;
 };
 
 VARIANT_ENUM_CAST(MariaDBConnectContext::Encoding);
 VARIANT_ENUM_CAST(MariaDBConnectContext::AuthType);
+VARIANT_ENUM_CAST(MariaDBConnectContext::ConnectStrategy);
@@ -0,0 +1,1078 @@
+/*************************************************************************/
+/*  mariadb_connection_pool.cpp                                          */
+/*************************************************************************/
+/*                     This file is part of the                          */
+/*                      MariaDBConnector addon                           */
+/*                    for use in the Godot Engine                        */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2021-2025 Shawn Shipton. https://vikingtinkerer.com     */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+#include "mariadb_connection_pool.hpp"
+#include "mariadb_router.hpp"
+
+#include <godot_cpp/classes/os.hpp>
+#include <godot_cpp/classes/time.hpp>
+#include <godot_cpp/classes/worker_thread_pool.hpp>
+#include <godot_cpp/core/error_macros.hpp>
+
+#include <algorithm>
+#include <chrono>
+
+namespace {
+
+// wsrep_local_state of a node that is in sync with the cluster, Joining 1, Donor/Desynced 2 and Joined 3 are not
+constexpr int kWsrepSynced = 4;
+// A node that refused a connection is skipped this long
+constexpr uint64_t kNodeRetryMsec = 1000;
+// Pass advance of a served priority class is kStride / weight
+constexpr uint64_t kStride = 1 << 20;
+const char *const kGaleraStatusSql =
+		"SHOW GLOBAL STATUS WHERE Variable_name IN ('wsrep_local_state', 'wsrep_ready')";
+
+uint64_t now_msec() { return Time::get_singleton()->get_ticks_msec(); }
+
+// Backtick quoted, a schema qualified name is quoted per part
+String quote_identifier(const String &p_name, const bool p_qualified) {
+	const PackedStringArray parts = p_qualified ? p_name.split(".") : PackedStringArray({ p_name });
+	String quoted;
+	for (int64_t i = 0; i < parts.size(); i++) {
+		if (i > 0) quoted += ".";
+		quoted += "`" + parts[i].replace("`", "``") + "`";
+	}
+	return quoted;
+}
+
+}  // namespace
+
+void MariaDBConnectionPool::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("add_node", "context"), &MariaDBConnectionPool::add_node);
+	ClassDB::bind_method(D_METHOD("get_node_count"), &MariaDBConnectionPool::get_node_count);
+	ClassDB::bind_method(D_METHOD("get_node_status"), &MariaDBConnectionPool::get_node_status);
+	ClassDB::bind_method(D_METHOD("set_max_size", "size"), &MariaDBConnectionPool::set_max_size);
+	ClassDB::bind_method(D_METHOD("get_max_size"), &MariaDBConnectionPool::get_max_size);
+	ClassDB::bind_method(D_METHOD("set_acquire_timeout", "msec"), &MariaDBConnectionPool::set_acquire_timeout);
+	ClassDB::bind_method(D_METHOD("get_acquire_timeout"), &MariaDBConnectionPool::get_acquire_timeout);
+	ClassDB::bind_method(D_METHOD("set_pin_writes", "enable"), &MariaDBConnectionPool::set_pin_writes);
+	ClassDB::bind_method(D_METHOD("is_pin_writes"), &MariaDBConnectionPool::is_pin_writes);
+	ClassDB::bind_method(D_METHOD("get_writer_node"), &MariaDBConnectionPool::get_writer_node);
+	ClassDB::bind_method(D_METHOD("get_open_count"), &MariaDBConnectionPool::get_open_count);
+	ClassDB::bind_method(D_METHOD("get_idle_count"), &MariaDBConnectionPool::get_idle_count);
+	ClassDB::bind_method(D_METHOD("warm_up", "count", "connects_per_sec"),
+			&MariaDBConnectionPool::warm_up,
+			DEFVAL(-1),
+			DEFVAL(0.0));
+	ClassDB::bind_method(D_METHOD("is_warming_up"), &MariaDBConnectionPool::is_warming_up);
+	ClassDB::bind_method(D_METHOD("acquire", "for_write", "priority", "timeout_msec"),
+			&MariaDBConnectionPool::acquire,
+			DEFVAL(true),
+			DEFVAL(PRIORITY_NORMAL),
+			DEFVAL(-1));
+	ClassDB::bind_method(D_METHOD("release", "connection"), &MariaDBConnectionPool::release);
+	ClassDB::bind_method(D_METHOD("select_query", "sql_stmt", "priority"),
+			&MariaDBConnectionPool::select_query,
+			DEFVAL(PRIORITY_NORMAL));
+	ClassDB::bind_method(
+			D_METHOD("query", "sql_stmt", "priority"), &MariaDBConnectionPool::query, DEFVAL(PRIORITY_NORMAL));
+	ClassDB::bind_method(D_METHOD("select_template", "template", "params", "priority"),
+			&MariaDBConnectionPool::select_template,
+			DEFVAL(PRIORITY_NORMAL));
+	ClassDB::bind_method(D_METHOD("run_parallel", "statements", "priority"),
+			&MariaDBConnectionPool::run_parallel,
+			DEFVAL(PRIORITY_NORMAL));
+	ClassDB::bind_method(D_METHOD("scan_ranges", "table", "key_column", "on_chunk", "columns", "where", "chunk_rows",
+								 "connections", "sync_snapshots"),
+			&MariaDBConnectionPool::scan_ranges,
+			DEFVAL("*"),
+			DEFVAL(""),
+			DEFVAL(1000),
+			DEFVAL(-1),
+			DEFVAL(false));
+	ClassDB::bind_method(
+			D_METHOD("set_priority_weight", "priority", "weight"), &MariaDBConnectionPool::set_priority_weight);
+	ClassDB::bind_method(D_METHOD("get_priority_weight", "priority"), &MariaDBConnectionPool::get_priority_weight);
+	ClassDB::bind_method(D_METHOD("get_admission_stats"), &MariaDBConnectionPool::get_admission_stats);
+	ClassDB::bind_method(D_METHOD("set_coalesce_reads", "enable"), &MariaDBConnectionPool::set_coalesce_reads);
+	ClassDB::bind_method(D_METHOD("is_coalesce_reads"), &MariaDBConnectionPool::is_coalesce_reads);
+	ClassDB::bind_method(D_METHOD("get_coalesced_count"), &MariaDBConnectionPool::get_coalesced_count);
+	ClassDB::bind_method(D_METHOD("set_reset_on_release", "enable"), &MariaDBConnectionPool::set_reset_on_release);
+	ClassDB::bind_method(D_METHOD("is_reset_on_release"), &MariaDBConnectionPool::is_reset_on_release);
+	ClassDB::bind_method(D_METHOD("get_last_error"), &MariaDBConnectionPool::get_last_error);
+	ClassDB::bind_method(D_METHOD("set_keepalive_interval", "msec"), &MariaDBConnectionPool::set_keepalive_interval);
+	ClassDB::bind_method(D_METHOD("get_keepalive_interval"), &MariaDBConnectionPool::get_keepalive_interval);
+	ClassDB::bind_method(D_METHOD("set_max_idle_time", "msec"), &MariaDBConnectionPool::set_max_idle_time);
+	ClassDB::bind_method(D_METHOD("get_max_idle_time"), &MariaDBConnectionPool::get_max_idle_time);
+	ClassDB::bind_method(D_METHOD("get_keepalive_stats"), &MariaDBConnectionPool::get_keepalive_stats);
+	ClassDB::bind_method(
+			D_METHOD("start_monitor", "interval_msec"), &MariaDBConnectionPool::start_monitor, DEFVAL(1000));
+	ClassDB::bind_method(D_METHOD("stop_monitor"), &MariaDBConnectionPool::stop_monitor);
+	ClassDB::bind_method(D_METHOD("is_monitoring"), &MariaDBConnectionPool::is_monitoring);
+	ClassDB::bind_method(D_METHOD("close"), &MariaDBConnectionPool::close);
+
+	ADD_SIGNAL(MethodInfo("warmed_up",
+			PropertyInfo(Variant::INT, "opened"),
+			PropertyInfo(Variant::INT, "failed"),
+			PropertyInfo(Variant::INT, "msec")));
+
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "max_size"), "set_max_size", "get_max_size");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "acquire_timeout"), "set_acquire_timeout", "get_acquire_timeout");
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "pin_writes"), "set_pin_writes", "is_pin_writes");
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "coalesce_reads"), "set_coalesce_reads", "is_coalesce_reads");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "keepalive_interval"), "set_keepalive_interval", "get_keepalive_interval");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "max_idle_time"), "set_max_idle_time", "get_max_idle_time");
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "reset_on_release"), "set_reset_on_release", "is_reset_on_release");
+
+	BIND_ENUM_CONSTANT(PRIORITY_CRITICAL);
+	BIND_ENUM_CONSTANT(PRIORITY_NORMAL);
+	BIND_ENUM_CONSTANT(PRIORITY_BACKGROUND);
+}
+
+MariaDBConnectionPool::MariaDBConnectionPool() {
+	_classes[PRIORITY_CRITICAL].weight = 8;
+	_classes[PRIORITY_NORMAL].weight = 4;
+	_classes[PRIORITY_BACKGROUND].weight = 1;
+}
+
+MariaDBConnectionPool::~MariaDBConnectionPool() { close(); }
+
+void MariaDBConnectionPool::add_node(const Ref<MariaDBConnectContext> &p_context) {
+	ERR_FAIL_COND_MSG(p_context.is_null(), "ConnectionContext is null.");
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	Node node;
+	node.context = p_context;
+	_nodes.push_back(node);
+	_released_cv.notify_all();
+}
+
+int MariaDBConnectionPool::get_node_count() {
+	std::lock_guard<std::mutex> lock(_mutex);
+	return (int)_nodes.size();
+}
+
+TypedArray<Dictionary> MariaDBConnectionPool::get_node_status() {
+	std::lock_guard<std::mutex> lock(_mutex);
+	const uint64_t now = now_msec();
+	TypedArray<Dictionary> status;
+	for (const Node &node : _nodes) {
+		Dictionary entry;
+		entry["hostname"] = node.context->get_hostname();
+		entry["wsrep_local_state"] = node.wsrep_state;
+		entry["wsrep_ready"] = node.wsrep_ready;
+		entry["usable"] = _node_usable(node, now);
+		entry["open"] = node.open;
+		status.push_back(entry);
+	}
+	return status;
+}
+
+void MariaDBConnectionPool::set_max_size(const int p_size) {
+	ERR_FAIL_COND_MSG(p_size <= 0, "Pool size must be positive.");
+	std::lock_guard<std::mutex> lock(_mutex);
+	_max_size = p_size;
+	_released_cv.notify_all();
+}
+
+int MariaDBConnectionPool::get_writer_node() {
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _writer_node(now_msec());
+}
+
+int MariaDBConnectionPool::get_open_count() {
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _open;
+}
+
+int MariaDBConnectionPool::get_idle_count() {
+	std::lock_guard<std::mutex> lock(_mutex);
+	return (int)_idle.size();
+}
+
+bool MariaDBConnectionPool::_node_usable(const Node &p_node, const uint64_t p_now_msec) const {
+	return p_node.synced && p_now_msec >= p_node.down_until_msec;
+}
+
+int MariaDBConnectionPool::_writer_node(const uint64_t p_now_msec) const {
+	// The first usable node in the order added, so every client of the cluster agrees on it
+	for (size_t i = 0; i < _nodes.size(); i++) {
+		if (_node_usable(_nodes[i], p_now_msec)) return (int)i;
+	}
+	return -1;
+}
+
+int MariaDBConnectionPool::_pick_node(const bool p_for_write, const uint64_t p_now_msec) const {
+	if (_pin_writes && p_for_write) return _writer_node(p_now_msec);
+
+	int best = -1;
+	for (size_t i = 0; i < _nodes.size(); i++) {
+		if (!_node_usable(_nodes[i], p_now_msec)) continue;
+		if (best < 0 || _nodes[i].open < _nodes[best].open) best = (int)i;
+	}
+	return best;
+}
+
+bool MariaDBConnectionPool::_has_waiters() const {
+	for (const PriorityClass &klass : _classes) {
+		if (!klass.waiters.empty()) return true;
+	}
+	return false;
+}
+
+int MariaDBConnectionPool::_next_class() const {
+	int next = -1;
+	for (int i = 0; i < PRIORITY_MAX; i++) {
+		if (_classes[i].waiters.empty()) continue;
+		// Ties go to the more important class
+		if (next < 0 || _classes[i].pass < _classes[next].pass) next = i;
+	}
+	return next;
+}
+
+uint64_t MariaDBConnectionPool::_estimate_wait_msec(const Priority p_priority) const {
+	if (_lease_usec_avg <= 0.0) return 0;
+
+	// Requests served before this one under the fair share, each holding one of max_size connections for the
+	// average lease
+	const PriorityClass &own = _classes[p_priority];
+	const double own_cnt = own.waiters.size() + 1.0;
+	double ahead = own_cnt;
+	for (int i = 0; i < PRIORITY_MAX; i++) {
+		if (i == p_priority) continue;
+		ahead += MIN((double)_classes[i].waiters.size(), own_cnt * _classes[i].weight / own.weight);
+	}
+	return (uint64_t)(ahead * _lease_usec_avg / _max_size / 1000.0);
+}
+
+void MariaDBConnectionPool::_close_pooled(const Pooled &p_pooled) {
+	p_pooled.conn->disconnect_db();
+	_nodes[p_pooled.node].open--;
+	_open--;
+}
+
+MariaDBConnectionPool::LeaseResult MariaDBConnectionPool::_try_lease(const bool p_for_write,
+		const uint64_t p_now_msec,
+		Pooled &r_pooled) {
+	const int writer = _pin_writes && p_for_write ? _writer_node(p_now_msec) : -1;
+	int spare = -1;
+
+	// Most recently released first, it is the least likely to have timed out on the server
+	for (size_t i = _idle.size(); i-- > 0;) {
+		if (!_node_usable(_nodes[_idle[i].node], p_now_msec)) {
+			_close_pooled(_idle[i]);
+			_idle.erase(_idle.begin() + i);
+			if (spare > (int)i) spare--;
+			continue;
+		}
+		if (writer >= 0 && _idle[i].node != writer) {
+			if (spare < 0) spare = (int)i;
+			continue;
+		}
+
+		r_pooled = _idle[i];
+		_idle.erase(_idle.begin() + i);
+		return LEASE_IDLE;
+	}
+
+	int node = _open < _max_size ? _pick_node(p_for_write, p_now_msec) : -1;
+	if (node < 0 && spare >= 0) {
+		// A pinned write in a full pool of other nodes' idle connections trades one for a writer connection
+		node = _pick_node(p_for_write, p_now_msec);
+		if (node >= 0) {
+			_close_pooled(_idle[spare]);
+			_idle.erase(_idle.begin() + spare);
+		}
+	}
+	if (node < 0) return LEASE_NONE;
+
+	// The slot is reserved while the caller connects outside the lock
+	_nodes[node].open++;
+	_open++;
+	r_pooled = Pooled();
+	r_pooled.node = node;
+	return LEASE_SLOT;
+}
+
+Ref<MariaDBConnector> MariaDBConnectionPool::acquire(const bool p_for_write,
+		const Priority p_priority,
+		const int p_timeout_msec) {
+	MariaDBConnector::ErrorCode error = MariaDBConnector::OK;
+	Ref<MariaDBConnector> conn = _acquire(p_for_write, p_priority, p_timeout_msec, error);
+	_last_error = error;
+	return conn;
+}
+
+Ref<MariaDBConnector> MariaDBConnectionPool::_acquire(const bool p_for_write,
+		const Priority p_priority,
+		const int p_timeout_msec,
+		MariaDBConnector::ErrorCode &r_error) {
+	r_error = MariaDBConnector::ERR_INVALID_PARAMETER;
+	ERR_FAIL_INDEX_V_MSG((int)p_priority, (int)PRIORITY_MAX, Ref<MariaDBConnector>(), "Invalid priority.");
+	const uint64_t deadline_msec = now_msec() + (p_timeout_msec < 0 ? _acquire_timeout_msec : p_timeout_msec);
+	PriorityClass &klass = _classes[p_priority];
+	uint64_t waiter_id = 0;
+	bool queued = false;
+
+	std::unique_lock<std::mutex> lock(_mutex);
+	while (!_closed) {
+		const uint64_t now = now_msec();
+		// Queued requests are served in fair share order, a new one only goes first while nobody waits
+		const bool my_turn = queued ? _next_class() == (int)p_priority && klass.waiters.front() == waiter_id
+									: !_has_waiters();
+		Pooled pooled;
+		const LeaseResult lease = my_turn ? _try_lease(p_for_write, now, pooled) : LEASE_NONE;
+
+		if (lease != LEASE_NONE) {
+			if (queued) {
+				klass.waiters.pop_front();
+				klass.pass += kStride / klass.weight;
+				_virtual_pass = klass.pass;
+				queued = false;
+				// The next in line may be served by what is left
+				_released_cv.notify_all();
+			}
+			if (lease == LEASE_SLOT) {
+				const Ref<MariaDBConnectContext> context = _nodes[pooled.node].context;
+				lock.unlock();
+				pooled.conn = _open_connection(context, r_error);
+				lock.lock();
+				if (pooled.conn.is_null()) {
+					_nodes[pooled.node].open--;
+					_open--;
+					_nodes[pooled.node].down_until_msec = now_msec() + kNodeRetryMsec;
+					_released_cv.notify_all();
+					continue;
+				}
+			}
+			klass.admitted++;
+			r_error = MariaDBConnector::OK;
+			pooled.leased_usec = Time::get_singleton()->get_ticks_usec();
+			_leased.push_back(pooled);
+			return pooled.conn;
+		}
+
+		if (!queued) {
+			// Shed at the door what would run out of time in the queue anyway
+			if (_estimate_wait_msec(p_priority) > deadline_msec - MIN(now, deadline_msec)) {
+				klass.rejected++;
+				r_error = MariaDBConnector::ERR_UNAVAILABLE;
+				return Ref<MariaDBConnector>();
+			}
+			// A class that was idle rejoins at the current pass instead of catching up on its share
+			if (klass.waiters.empty()) klass.pass = MAX(klass.pass, _virtual_pass);
+			waiter_id = _next_waiter_id++;
+			klass.waiters.push_back(waiter_id);
+			queued = true;
+		}
+
+		if (now >= deadline_msec) break;
+		// Nobody notifies when a down node's retry time passes, wake up for it
+		uint64_t wake_msec = deadline_msec;
+		for (const Node &node : _nodes) {
+			if (node.down_until_msec > now) wake_msec = MIN(wake_msec, node.down_until_msec);
+		}
+		_released_cv.wait_for(lock, std::chrono::milliseconds(wake_msec - now));
+	}
+
+	if (queued) {
+		klass.waiters.erase(std::find(klass.waiters.begin(), klass.waiters.end(), waiter_id));
+		_released_cv.notify_all();
+	}
+	if (!_closed) klass.timed_out++;
+	r_error = MariaDBConnector::ERR_UNAVAILABLE;
+	return Ref<MariaDBConnector>();
+}
+
+Ref<MariaDBConnector> MariaDBConnectionPool::_open_connection(const Ref<MariaDBConnectContext> &p_context,
+		MariaDBConnector::ErrorCode &r_error) {
+	Ref<MariaDBConnector> conn;
+	conn.instantiate();
+	r_error = conn->connect_db_ctx(p_context);
+	if (r_error != MariaDBConnector::OK) return Ref<MariaDBConnector>();
+	return conn;
+}
+
+void MariaDBConnectionPool::release(const Ref<MariaDBConnector> &p_conn) {
+	ERR_FAIL_COND_MSG(p_conn.is_null(), "Connection is null.");
+
+	// Polls the socket and resets the session, done before taking the lock
+	bool reusable = p_conn->is_connected_db() && !p_conn->is_in_transaction();
+	if (reusable && _reset_on_release) reusable = p_conn->reset_session() == MariaDBConnector::OK;
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	size_t idx = 0;
+	while (idx < _leased.size() && _leased[idx].conn != p_conn) idx++;
+	ERR_FAIL_COND_MSG(idx == _leased.size(), "Connection was not acquired from this pool.");
+
+	const Pooled pooled = _leased[idx];
+	_leased.erase(_leased.begin() + idx);
+	const double held_usec = (double)(Time::get_singleton()->get_ticks_usec() - pooled.leased_usec);
+	_lease_usec_avg = _lease_usec_avg <= 0.0 ? held_usec : _lease_usec_avg * 0.9 + held_usec * 0.1;
+
+	if (reusable && !_closed && _node_usable(_nodes[pooled.node], now_msec())) {
+		_idle.push_back(pooled);
+		_idle.back().idle_since_msec = now_msec();
+	} else {
+		_close_pooled(pooled);
+	}
+	// Every waiter checks whether it is next in the fair share order
+	_released_cv.notify_all();
+}
+
+void MariaDBConnectionPool::set_priority_weight(const Priority p_priority, const int p_weight) {
+	ERR_FAIL_INDEX_MSG((int)p_priority, (int)PRIORITY_MAX, "Invalid priority.");
+	ERR_FAIL_COND_MSG(p_weight <= 0, "Priority weight must be positive.");
+	std::lock_guard<std::mutex> lock(_mutex);
+	_classes[p_priority].weight = p_weight;
+}
+
+int MariaDBConnectionPool::get_priority_weight(const Priority p_priority) const {
+	ERR_FAIL_INDEX_V_MSG((int)p_priority, (int)PRIORITY_MAX, 0, "Invalid priority.");
+	return _classes[p_priority].weight;
+}
+
+Dictionary MariaDBConnectionPool::get_admission_stats() {
+	static const char *const kClassNames[PRIORITY_MAX] = { "critical", "normal", "background" };
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	Dictionary stats;
+	for (int i = 0; i < PRIORITY_MAX; i++) {
+		Dictionary entry;
+		entry["admitted"] = _classes[i].admitted;
+		entry["rejected"] = _classes[i].rejected;
+		entry["timed_out"] = _classes[i].timed_out;
+		entry["waiting"] = (int64_t)_classes[i].waiters.size();
+		stats[kClassNames[i]] = entry;
+	}
+	return stats;
+}
+
+Variant MariaDBConnectionPool::_run(const String &p_sql,
+		const bool p_select,
+		const Priority p_priority,
+		MariaDBConnector::ErrorCode &r_error,
+		const Ref<MariaDBQueryTemplate> &p_template,
+		const Array &p_params) {
+	Ref<MariaDBConnector> conn = _acquire(!MariaDBRouter::is_replica_safe(p_sql), p_priority, -1, r_error);
+	if (conn.is_null()) {
+		ERR_PRINT("No pooled connection available.");
+		return p_select ? Variant(TypedArray<Dictionary>()) : Variant(MariaDBConnector::ERR_UNAVAILABLE);
+	}
+
+	Variant result;
+	if (p_template.is_valid()) {
+		result = conn->select_template(p_template, p_params);
+	} else {
+		result = p_select ? Variant(conn->select_query(p_sql)) : conn->query(p_sql);
+	}
+	// Read before release, which runs reset_session on the same connector
+	r_error = conn->get_last_error();
+	release(conn);
+	return result;
+}
+
+TypedArray<Dictionary> MariaDBConnectionPool::_select(const String &p_sql,
+		const Priority p_priority,
+		MariaDBConnector::ErrorCode &r_error,
+		const Ref<MariaDBQueryTemplate> &p_template,
+		const Array &p_params) {
+	if (!_coalesce_reads || !MariaDBRouter::is_replica_safe(p_sql)) {
+		return TypedArray<Dictionary>(Array(_run(p_sql, true, p_priority, r_error, p_template, p_params)));
+	}
+
+	std::unique_lock<std::mutex> lock(_flight_mutex);
+	std::shared_ptr<Flight> *in_flight = _flights.getptr(p_sql);
+	if (in_flight) {
+		const std::shared_ptr<Flight> flight = *in_flight;
+		flight->followers++;
+		// Waits no longer than its own acquire would, a leader stuck in a long queue is not worth following
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(_acquire_timeout_msec);
+		if (_flight_cv.wait_until(lock, deadline, [&flight] { return flight->done; })) {
+			lock.unlock();
+			_coalesced++;
+			r_error = flight->error;
+			// The published rows are never modified, each follower copies them for itself
+			return TypedArray<Dictionary>(flight->rows.duplicate(true));
+		}
+		flight->followers--;
+		lock.unlock();
+		return TypedArray<Dictionary>(Array(_run(p_sql, true, p_priority, r_error, p_template, p_params)));
+	}
+
+	const std::shared_ptr<Flight> flight = std::make_shared<Flight>();
+	_flights.insert(p_sql, flight);
+	lock.unlock();
+
+	TypedArray<Dictionary> rows(Array(_run(p_sql, true, p_priority, r_error, p_template, p_params)));
+
+	lock.lock();
+	// Nobody can join once the key is gone, so the follower count is final here
+	_flights.erase(p_sql);
+	if (flight->followers > 0) flight->rows = TypedArray<Dictionary>(rows.duplicate(true));
+	// The leader's own result, another caller may have set _last_error meanwhile
+	flight->error = r_error;
+	flight->done = true;
+	lock.unlock();
+	_flight_cv.notify_all();
+	return rows;
+}
+
+TypedArray<Dictionary> MariaDBConnectionPool::select_query(const String &p_sql, const Priority p_priority) {
+	MariaDBConnector::ErrorCode error = MariaDBConnector::OK;
+	const TypedArray<Dictionary> rows = _select(p_sql, p_priority, error);
+	_last_error = error;
+	return rows;
+}
+
+TypedArray<Dictionary> MariaDBConnectionPool::select_template(const Ref<MariaDBQueryTemplate> &p_template,
+		const Array &p_params,
+		const Priority p_priority) {
+	ERR_FAIL_COND_V_MSG(p_template.is_null(), TypedArray<Dictionary>(), "Template is null.");
+	// Rendered only when it can be shared, the key has to include the params
+	const String sql = _coalesce_reads ? p_template->render(p_params) : p_template->get_sql();
+	MariaDBConnector::ErrorCode error = MariaDBConnector::OK;
+	const TypedArray<Dictionary> rows = _select(sql, p_priority, error, p_template, p_params);
+	_last_error = error;
+	return rows;
+}
+
+Variant MariaDBConnectionPool::query(const String &p_sql, const Priority p_priority) {
+	MariaDBConnector::ErrorCode error = MariaDBConnector::OK;
+	const Variant result = _run(p_sql, false, p_priority, error);
+	_last_error = error;
+	return result;
+}
+
+void MariaDBConnectionPool::_parallel_task(void *p_userdata, uint32_t p_index) {
+	ParallelJob *job = static_cast<ParallelJob *>(p_userdata);
+	const Ref<MariaDBQueryTemplate> &sql_template = job->templates[p_index];
+	const String &sql = sql_template.is_valid() ? sql_template->get_sql() : job->sql[p_index];
+
+	Ref<MariaDBConnector> conn =
+			job->pool->_acquire(!MariaDBRouter::is_replica_safe(sql), job->priority, -1, job->errors[p_index]);
+	if (conn.is_null()) {
+		job->results[p_index] = MariaDBConnector::ERR_UNAVAILABLE;
+		return;
+	}
+
+	job->results[p_index] = sql_template.is_valid() ? conn->query_template(sql_template, job->params[p_index])
+													: conn->query(sql);
+	job->errors[p_index] = conn->get_last_error();
+	job->pool->release(conn);
+}
+
+Array MariaDBConnectionPool::run_parallel(const Array &p_statements, const Priority p_priority) {
+	const int64_t count = p_statements.size();
+	ParallelJob job;
+	job.pool = this;
+	job.priority = p_priority;
+	job.sql.resize(count);
+	job.templates.resize(count);
+	job.params.resize(count);
+	job.results.resize(count);
+	job.errors.resize(count, MariaDBConnector::OK);
+
+	for (int64_t i = 0; i < count; i++) {
+		const Variant &stmt = p_statements[i];
+		if (stmt.get_type() == Variant::STRING) {
+			job.sql[i] = stmt;
+			continue;
+		}
+		const Array pair = stmt.get_type() == Variant::ARRAY ? Array(stmt) : Array();
+		job.templates[i] = pair.size() == 2 ? Ref<MariaDBQueryTemplate>(pair[0]) : Ref<MariaDBQueryTemplate>();
+		ERR_FAIL_COND_V_MSG(job.templates[i].is_null() || pair[1].get_type() != Variant::ARRAY,
+				Array(),
+				vformat("Statement %d is neither a String nor [MariaDBQueryTemplate, params].", i));
+		job.params[i] = pair[1];
+	}
+
+	Array results;
+	if (count == 0) {
+		_last_error = MariaDBConnector::OK;
+		return results;
+	}
+
+	int tasks;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		tasks = (int)MIN(count, (int64_t)_max_size);
+	}
+	// No more workers than connections, an extra one would only sit in acquire
+	WorkerThreadPool *pool = WorkerThreadPool::get_singleton();
+	const int64_t task_id = pool->add_native_group_task(
+			&MariaDBConnectionPool::_parallel_task, &job, (int)count, tasks, true, "MariaDB parallel");
+	pool->wait_for_group_task_completion(task_id);
+
+	MariaDBConnector::ErrorCode error = MariaDBConnector::OK;
+	results.resize(count);
+	for (int64_t i = 0; i < count; i++) {
+		if (job.errors[i] != MariaDBConnector::OK && error == MariaDBConnector::OK) error = job.errors[i];
+		results[i] = job.results[i];
+	}
+	_last_error = error;
+	return results;
+}
+
+void MariaDBConnectionPool::_scan_task(void *p_userdata, uint32_t p_index) {
+	ScanJob *job = static_cast<ScanJob *>(p_userdata);
+	const Ref<MariaDBConnector> &conn = job->conns[p_index];
+	int64_t lower = job->ranges[p_index].first;
+	const int64_t upper = job->ranges[p_index].second;
+	// Keyset pagination, the first batch includes the lower bound, later ones start after the last key seen
+	const char *lower_op = ">=";
+
+	while (true) {
+		const String sql = vformat("%s%s %s %d AND %s <= %d ORDER BY %s LIMIT %d",
+				job->select_head,
+				job->key_sql,
+				lower_op,
+				lower,
+				job->key_sql,
+				upper,
+				job->key_sql,
+				job->chunk_rows);
+		const TypedArray<Dictionary> rows = conn->select_query(sql);
+		MariaDBConnector::ErrorCode error = conn->get_last_error();
+		Variant last_key;
+		if (error == MariaDBConnector::OK && !rows.is_empty()) {
+			last_key = Dictionary(rows[rows.size() - 1]).get(job->key_name, Variant());
+			// The key column has to be among the selected columns to page on it
+			if (last_key.get_type() != Variant::INT) error = MariaDBConnector::ERR_INVALID_PARAMETER;
+		}
+
+		std::unique_lock<std::mutex> lock(job->mutex);
+		if (error != MariaDBConnector::OK) {
+			if (job->error == MariaDBConnector::OK) job->error = error;
+			job->cancel = true;
+			break;
+		}
+		if (rows.is_empty()) break;
+		job->cv.wait(lock, [job] { return job->cancel || job->chunks.size() < job->max_chunks; });
+		if (job->cancel) break;
+		job->chunks.emplace_back((int)p_index, rows);
+		job->cv.notify_all();
+
+		if (rows.size() < job->chunk_rows || (int64_t)last_key == upper) break;
+		lower = last_key;
+		lower_op = ">";
+	}
+
+	std::lock_guard<std::mutex> lock(job->mutex);
+	job->finished++;
+	job->cv.notify_all();
+}
+
+MariaDBConnector::ErrorCode MariaDBConnectionPool::scan_ranges(const String &p_table,
+		const String &p_key_column,
+		const Callable &p_on_chunk,
+		const String &p_columns,
+		const String &p_where,
+		const int p_chunk_rows,
+		const int p_connections,
+		const bool p_sync_snapshots) {
+	ERR_FAIL_COND_V_MSG(p_table.is_empty() || p_key_column.is_empty(),
+			MariaDBConnector::ERR_INVALID_PARAMETER,
+			"Table and key column are required.");
+	ERR_FAIL_COND_V_MSG(!p_on_chunk.is_valid(), MariaDBConnector::ERR_INVALID_PARAMETER, "on_chunk is not valid.");
+	ERR_FAIL_COND_V_MSG(p_chunk_rows <= 0, MariaDBConnector::ERR_INVALID_PARAMETER, "chunk_rows must be positive.");
+
+	int count;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		// FLUSH TABLES WITH READ LOCK only holds the server it ran on, every connection must be on that one
+		ERR_FAIL_COND_V_MSG(p_sync_snapshots && _nodes.size() > 1 && !_pin_writes,
+				MariaDBConnector::ERR_INVALID_PARAMETER,
+				"sync_snapshots needs a single node or pin_writes.");
+		// The read lock is held on one more connection
+		count = MIN(p_connections < 0 ? _max_size : p_connections, _max_size - (p_sync_snapshots ? 1 : 0));
+	}
+	ERR_FAIL_COND_V_MSG(count <= 0, MariaDBConnector::ERR_INVALID_PARAMETER, "No connection left to scan with.");
+
+	ScanJob job;
+	const String table_sql = quote_identifier(p_table, true);
+	const String where_sql = p_where.is_empty() ? String("1") : p_where;
+	job.select_head = vformat("SELECT %s FROM %s WHERE (%s) AND ", p_columns, table_sql, where_sql);
+	job.key_sql = quote_identifier(p_key_column, false);
+	job.key_name = p_key_column;
+	job.chunk_rows = p_chunk_rows;
+
+	Ref<MariaDBConnector> lock_conn;
+	MariaDBConnector::ErrorCode error = MariaDBConnector::OK;
+	auto end_scan = [&]() {
+		if (lock_conn.is_valid()) {
+			lock_conn->query("UNLOCK TABLES");
+			release(lock_conn);
+		}
+		for (const Ref<MariaDBConnector> &conn : job.conns) {
+			// Read only, ending it keeps the connection reusable
+			conn->query("COMMIT");
+			release(conn);
+		}
+		_last_error = error;
+		return error;
+	};
+
+	if (p_sync_snapshots) {
+		lock_conn = _acquire(true, PRIORITY_NORMAL, -1, error);
+		if (lock_conn.is_null()) return end_scan();
+		lock_conn->query("FLUSH TABLES WITH READ LOCK");
+		error = lock_conn->get_last_error();
+		if (error != MariaDBConnector::OK) return end_scan();
+	}
+	for (int i = 0; i < count && error == MariaDBConnector::OK; i++) {
+		// Only the first connection is waited for, the scan is split over however many are free after it.
+		// Pinned writes keep a synchronized scan on the server holding the lock.
+		Ref<MariaDBConnector> conn = _acquire(p_sync_snapshots, PRIORITY_NORMAL, i == 0 ? -1 : 0, error);
+		if (conn.is_null()) {
+			if (i > 0) error = MariaDBConnector::OK;
+			break;
+		}
+		job.conns.push_back(conn);
+		conn->query("START TRANSACTION WITH CONSISTENT SNAPSHOT");
+		error = conn->get_last_error();
+	}
+	if (lock_conn.is_valid()) {
+		// Every snapshot is taken, writers may go on
+		lock_conn->query("UNLOCK TABLES");
+		release(lock_conn);
+		lock_conn.unref();
+	}
+	if (error != MariaDBConnector::OK) return end_scan();
+
+	// Bounds as of the snapshot
+	const TypedArray<Dictionary> bounds = job.conns[0]->select_query(vformat(
+			"SELECT MIN(%s) AS lo, MAX(%s) AS hi FROM %s WHERE (%s)", job.key_sql, job.key_sql, table_sql, where_sql));
+	error = job.conns[0]->get_last_error();
+	if (error != MariaDBConnector::OK || bounds.is_empty()) return end_scan();
+	const Dictionary bound = bounds[0];
+	if (bound["lo"].get_type() == Variant::NIL) return end_scan();
+	if (bound["lo"].get_type() != Variant::INT || bound["hi"].get_type() != Variant::INT) {
+		ERR_PRINT(vformat("Key column %s is not an integer.", p_key_column));
+		error = MariaDBConnector::ERR_INVALID_PARAMETER;
+		return end_scan();
+	}
+
+	// Equal key spans, computed unsigned so the full int64 range does not overflow
+	const int64_t lo = bound["lo"];
+	const uint64_t width = (uint64_t)(int64_t)bound["hi"] - (uint64_t)lo;
+	const uint64_t step = width / job.conns.size() + 1;
+	for (uint64_t i = 0; i < job.conns.size() && i * step <= width; i++) {
+		const uint64_t first = i * step;
+		const uint64_t last = MIN(first + step - 1, width);
+		job.ranges.emplace_back((int64_t)((uint64_t)lo + first), (int64_t)((uint64_t)lo + last));
+	}
+	job.max_chunks = 2 * job.ranges.size();
+
+	WorkerThreadPool *pool = WorkerThreadPool::get_singleton();
+	const int64_t task_id = pool->add_native_group_task(&MariaDBConnectionPool::_scan_task,
+			&job,
+			(int)job.ranges.size(),
+			(int)job.ranges.size(),
+			true,
+			"MariaDB range scan");
+
+	// The callback runs here, one chunk at a time, while the tasks keep scanning
+	while (true) {
+		std::unique_lock<std::mutex> lock(job.mutex);
+		job.cv.wait(lock, [&job] { return !job.chunks.empty() || job.finished == job.ranges.size(); });
+		if (job.chunks.empty()) break;
+		const std::pair<int, TypedArray<Dictionary>> chunk = job.chunks.front();
+		job.chunks.pop_front();
+		job.cv.notify_all();
+		lock.unlock();
+
+		const Variant ret = p_on_chunk.call(chunk.second, chunk.first);
+		if (ret.get_type() == Variant::BOOL && !(bool)ret) {
+			lock.lock();
+			job.cancel = true;
+			job.chunks.clear();
+			job.cv.notify_all();
+		}
+	}
+	pool->wait_for_group_task_completion(task_id);
+
+	error = job.error;
+	if (error == MariaDBConnector::ERR_INVALID_PARAMETER) {
+		ERR_PRINT(vformat("Key column %s is not selected as an integer.", p_key_column));
+	}
+	return end_scan();
+}
+
+void MariaDBConnectionPool::set_keepalive_interval(const int p_msec) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	_keepalive_msec = MAX(p_msec, 0);
+}
+
+void MariaDBConnectionPool::set_max_idle_time(const int p_msec) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	_max_idle_msec = MAX(p_msec, 0);
+}
+
+Dictionary MariaDBConnectionPool::get_keepalive_stats() {
+	std::lock_guard<std::mutex> lock(_mutex);
+	Dictionary stats;
+	stats["pinged"] = _pinged;
+	stats["dead"] = _dead;
+	stats["reaped"] = _reaped;
+	return stats;
+}
+
+void MariaDBConnectionPool::start_monitor(const int p_interval_msec) {
+	ERR_FAIL_COND_MSG(p_interval_msec <= 0, "Monitor interval must be positive.");
+	{
+		std::lock_guard<std::mutex> lock(_monitor_mutex);
+		_monitor_interval_msec = p_interval_msec;
+		_monitor_stop = false;
+	}
+	if (!_monitor_thread.joinable()) _monitor_thread = std::thread([this] { _monitor_loop(); });
+}
+
+void MariaDBConnectionPool::stop_monitor() {
+	if (!_monitor_thread.joinable()) return;
+	{
+		std::lock_guard<std::mutex> lock(_monitor_mutex);
+		_monitor_stop = true;
+	}
+	_monitor_cv.notify_all();
+	_monitor_thread.join();
+}
+
+void MariaDBConnectionPool::warm_up(const int p_count, const double p_connects_per_sec) {
+	ERR_FAIL_COND_MSG(_warming_up, "A warm-up is already running.");
+	if (_warm_up_thread.joinable()) _warm_up_thread.join();
+
+	std::shared_ptr<WarmUpJob> job = std::make_shared<WarmUpJob>();
+	job->pool = this;
+	job->connects_per_sec = p_connects_per_sec;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		ERR_FAIL_COND_MSG(_closed, "Pool is closed.");
+
+		// Slots are reserved up front, spread over the nodes like on-demand connects are
+		const int target = p_count < 0 ? _max_size : MIN(p_count, _max_size);
+		const uint64_t now = now_msec();
+		while (_open < target) {
+			const int node = _pick_node(false, now);
+			if (node < 0) break;
+			_nodes[node].open++;
+			_open++;
+			job->slots.push_back(std::make_pair(node, _nodes[node].context));
+		}
+	}
+
+	// Waited on from a thread of its own so the caller returns at once, the connects run on the WorkerThreadPool
+	_warming_up = true;
+	_warm_up_thread = std::thread([this, job] {
+		job->start_usec = Time::get_singleton()->get_ticks_usec();
+		if (!job->slots.empty()) {
+			WorkerThreadPool *pool = WorkerThreadPool::get_singleton();
+			const int64_t task_id = pool->add_native_group_task(&MariaDBConnectionPool::_warm_up_task,
+					job.get(),
+					(int)job->slots.size(),
+					-1,
+					false,
+					"MariaDB pool warm-up");
+			pool->wait_for_group_task_completion(task_id);
+		}
+		const int64_t msec = (Time::get_singleton()->get_ticks_usec() - job->start_usec) / 1000;
+		_warming_up = false;
+		call_deferred("emit_signal", "warmed_up", job->opened.load(), job->failed.load(), msec);
+	});
+}
+
+void MariaDBConnectionPool::_warm_up_task(void *p_userdata, uint32_t p_index) {
+	WarmUpJob *job = static_cast<WarmUpJob *>(p_userdata);
+	if (job->connects_per_sec > 0.0) {
+		// Connect i starts i / connects_per_sec after the first, however many workers are free
+		const uint64_t start_usec = job->start_usec + (uint64_t)(p_index * 1000000.0 / job->connects_per_sec);
+		const uint64_t now_usec = Time::get_singleton()->get_ticks_usec();
+		if (start_usec > now_usec) OS::get_singleton()->delay_usec(start_usec - now_usec);
+	}
+
+	Ref<MariaDBConnector> conn;
+	conn.instantiate();
+	if (conn->connect_db_ctx(job->slots[p_index].second) == MariaDBConnector::OK) {
+		job->opened++;
+	} else {
+		conn.unref();
+		job->failed++;
+	}
+	job->pool->_add_warmed(job->slots[p_index].first, conn);
+}
+
+void MariaDBConnectionPool::_add_warmed(const int p_node, const Ref<MariaDBConnector> &p_conn) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	if (p_conn.is_valid() && !_closed) {
+		Pooled pooled;
+		pooled.conn = p_conn;
+		pooled.node = p_node;
+		pooled.idle_since_msec = now_msec();
+		_idle.push_back(pooled);
+	} else {
+		if (p_conn.is_valid()) p_conn->disconnect_db();
+		if (p_conn.is_null()) _nodes[p_node].down_until_msec = now_msec() + kNodeRetryMsec;
+		_nodes[p_node].open--;
+		_open--;
+	}
+	_released_cv.notify_all();
+}
+
+void MariaDBConnectionPool::close() {
+	stop_monitor();
+	if (_warm_up_thread.joinable()) _warm_up_thread.join();
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	_closed = true;
+	for (Pooled &pooled : _idle) {
+		pooled.conn->disconnect_db();
+		_nodes[pooled.node].open--;
+		_open--;
+	}
+	_idle.clear();
+	for (Node &node : _nodes) {
+		if (node.monitor.is_valid()) node.monitor->disconnect_db();
+		node.monitor.unref();
+	}
+	_released_cv.notify_all();
+}
+
+void MariaDBConnectionPool::_monitor_loop() {
+	std::unique_lock<std::mutex> monitor_lock(_monitor_mutex);
+	while (!_monitor_stop) {
+		monitor_lock.unlock();
+		int node_cnt = 0;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			node_cnt = (int)_nodes.size();
+		}
+		for (int i = 0; i < node_cnt; i++) _check_node(i);
+		_maintain_idle();
+
+		monitor_lock.lock();
+		_monitor_cv.wait_for(monitor_lock,
+				std::chrono::milliseconds(_monitor_interval_msec),
+				[this] { return _monitor_stop; });
+	}
+}
+
+void MariaDBConnectionPool::_check_node(const int p_node) {
+	Ref<MariaDBConnectContext> context;
+	Ref<MariaDBConnector> monitor;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		context = _nodes[p_node].context;
+		monitor = _nodes[p_node].monitor;
+	}
+
+	// One status query per node on a connection of its own, the pooled ones stay with the callers
+	if (monitor.is_null()) monitor.instantiate();
+	bool reachable = monitor->is_connected_db();
+	uint64_t wait_timeout_msec = 0;
+	if (!reachable && monitor->connect_db_ctx(context) == MariaDBConnector::OK) {
+		reachable = true;
+		// Read once per connect, the keepalive has to stay ahead of it
+		const TypedArray<Dictionary> rows = monitor->select_query("SELECT @@wait_timeout AS wait_timeout");
+		if (!rows.is_empty()) wait_timeout_msec = (uint64_t)Dictionary(rows[0]).get("wait_timeout", 0) * 1000;
+	}
+	int state = -1;
+	bool ready = true;
+	if (reachable) {
+		const TypedArray<Dictionary> rows = monitor->select_query(kGaleraStatusSql);
+		reachable = monitor->get_last_error() == MariaDBConnector::OK;
+		for (int i = 0; i < rows.size(); i++) {
+			const Dictionary row = rows[i];
+			const String name = String(row.get("Variable_name", "")).to_lower();
+			const String value = row.get("Value", "");
+			if (name == "wsrep_local_state") {
+				state = value.to_int();
+			} else if (name == "wsrep_ready") {
+				ready = value == "ON";
+			}
+		}
+	}
+	// A server without wsrep variables is not a Galera node, it only has to be reachable
+	const bool synced = reachable && ready && (state < 0 || state == kWsrepSynced);
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	Node &node = _nodes[p_node];
+	node.monitor = monitor;
+	if (wait_timeout_msec > 0) node.wait_timeout_msec = wait_timeout_msec;
+	node.wsrep_state = state;
+	node.wsrep_ready = ready;
+	if (synced && !node.synced) _released_cv.notify_all();
+	node.synced = synced;
+	if (synced) node.down_until_msec = 0;
+}
+
+uint64_t MariaDBConnectionPool::_keepalive_due_msec(const Node &p_node) const {
+	if (_keepalive_msec <= 0) return UINT64_MAX;
+	// Pinged well before the server drops it for being idle
+	if (p_node.wait_timeout_msec > 0) return MIN((uint64_t)_keepalive_msec, p_node.wait_timeout_msec / 2);
+	return _keepalive_msec;
+}
+
+void MariaDBConnectionPool::_maintain_idle() {
+	std::vector<Pooled> due;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (_closed) return;
+		const uint64_t now = now_msec();
+		for (size_t i = _idle.size(); i-- > 0;) {
+			const uint64_t idle_msec = now - MIN(now, _idle[i].idle_since_msec);
+			if (_max_idle_msec > 0 && idle_msec >= (uint64_t)_max_idle_msec) {
+				_close_pooled(_idle[i]);
+				_idle.erase(_idle.begin() + i);
+				_reaped++;
+			} else if (idle_msec >= _keepalive_due_msec(_nodes[_idle[i].node])) {
+				// Out of the idle list while pinged, no caller can lease it meanwhile, its slot stays taken
+				due.push_back(_idle[i]);
+				_idle.erase(_idle.begin() + i);
+			}
+		}
+	}
+
+	for (Pooled &pooled : due) {
+		const bool alive = pooled.conn->ping_srvr() == MariaDBConnector::OK;
+		Ref<MariaDBConnectContext> context;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_pinged++;
+			if (alive && !_closed) {
+				pooled.idle_since_msec = now_msec();
+				_idle.push_back(pooled);
+			} else if (!alive && !_closed && _node_usable(_nodes[pooled.node], now_msec())) {
+				// Replaced while nobody waits for it, the slot is kept for the new connection
+				_dead++;
+				context = _nodes[pooled.node].context;
+			} else {
+				if (!alive) _dead++;
+				_close_pooled(pooled);
+			}
+			_released_cv.notify_all();
+		}
+		if (context.is_null()) continue;
+
+		pooled.conn->disconnect_db();
+		MariaDBConnector::ErrorCode error;
+		_add_warmed(pooled.node, _open_connection(context, error));
+	}
+}
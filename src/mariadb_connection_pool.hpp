@@ -0,0 +1,373 @@
+/*************************************************************************/
+/*  mariadb_connection_pool.hpp                                          */
+/*************************************************************************/
+/*                     This file is part of the                          */
+/*                      MariaDBConnector addon                           */
+/*                    for use in the Godot Engine                        */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2021-2025 Shawn Shipton. https://vikingtinkerer.com     */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+#pragma once
+
+#include "mariadb_connect_context.hpp"
+#include "mariadb_connector.hpp"
+
+#include <godot_cpp/classes/ref_counted.hpp>
+#include <godot_cpp/core/class_db.hpp>
+#include <godot_cpp/templates/hash_map.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using namespace godot;
+
+/**
+ * \brief		Thread safe pool of connections over one or more servers, typically the nodes of a Galera cluster.
+ *				A background monitor checks wsrep_local_state and wsrep_ready of every node on its own connection,
+ *				nodes that are not synced are skipped until they are again. Writes can be pinned to one node to
+ *				avoid certification conflicts between nodes.
+ */
+class MariaDBConnectionPool : public RefCounted {
+	GDCLASS(MariaDBConnectionPool, RefCounted);
+
+public:
+	enum Priority {
+		PRIORITY_CRITICAL,
+		PRIORITY_NORMAL,
+		PRIORITY_BACKGROUND,
+		PRIORITY_MAX
+	};
+
+	void add_node(const Ref<MariaDBConnectContext> &p_context);
+	int get_node_count();
+	/**
+	 * \brief		One Dictionary per node with "hostname", "wsrep_local_state", -1 for a server that is not a Galera
+	 *				node or before the first check, "wsrep_ready", "usable" and "open" connections.
+	 */
+	TypedArray<Dictionary> get_node_status();
+
+	void set_max_size(const int p_size);
+	int get_max_size() const { return _max_size; }
+	void set_acquire_timeout(const int p_msec) { _acquire_timeout_msec = MAX(p_msec, 0); }
+	int get_acquire_timeout() const { return _acquire_timeout_msec; }
+	/**
+	 * \brief		Writes go to the first usable node in the order added, all nodes take reads.
+	 */
+	void set_pin_writes(const bool p_enable) { _pin_writes = p_enable; }
+	bool is_pin_writes() const { return _pin_writes; }
+	/**
+	 * \brief		Node that takes the writes while pinned, -1 if none is usable.
+	 */
+	int get_writer_node();
+	int get_open_count();
+	int get_idle_count();
+
+	/**
+	 * \brief		Opens connections concurrently on the WorkerThreadPool until count are open, max_size for -1,
+	 *				starting at most connects_per_sec per second, 0 for no cap. Returns at once, warmed_up is
+	 *				emitted on the main thread when the last connect finished.
+	 */
+	void warm_up(const int p_count = -1, const double p_connects_per_sec = 0.0);
+	bool is_warming_up() const { return _warming_up; }
+
+	/**
+	 * \brief		Idle connection to a usable node, a new one while below max_size, otherwise queues in its priority
+	 *				class until a connection frees up or timeout_msec, the acquire timeout for -1, has passed.
+	 *				Queued classes are served by weighted fair share, a request whose estimated wait already
+	 *				exceeds its timeout is rejected at once. Null on rejection, timeout or when no node can be
+	 *				connected.
+	 */
+	Ref<MariaDBConnector> acquire(const bool p_for_write = true,
+			const Priority p_priority = PRIORITY_NORMAL,
+			const int p_timeout_msec = -1);
+	/**
+	 * \brief		Returns a connection, it is closed instead of kept when lost, in a transaction, its session
+	 *				reset failed or its node is no longer usable.
+	 */
+	void release(const Ref<MariaDBConnector> &p_conn);
+	/**
+	 * \brief		Acquire, run and release, a statement that is not replica safe counts as a write.
+	 */
+	TypedArray<Dictionary> select_query(const String &p_sql, const Priority p_priority = PRIORITY_NORMAL);
+	Variant query(const String &p_sql, const Priority p_priority = PRIORITY_NORMAL);
+	TypedArray<Dictionary> select_template(const Ref<MariaDBQueryTemplate> &p_template,
+			const Array &p_params,
+			const Priority p_priority = PRIORITY_NORMAL);
+	/**
+	 * \brief		Runs independent statements concurrently on up to max_size pooled connections, each a String
+	 *				or an Array [MariaDBQueryTemplate, params]. Blocks until the last one finished and returns
+	 *				what query or query_template returned for each, in the order given.
+	 */
+	Array run_parallel(const Array &p_statements, const Priority p_priority = PRIORITY_NORMAL);
+	/**
+	 * \brief		Splits the integer key_column of table into ranges, one per pooled connection, connections for -1
+	 *				is max_size, and scans them concurrently in chunk_rows batches, each connection inside START
+	 *				TRANSACTION WITH CONSISTENT SNAPSHOT. The chunks are passed to on_chunk(rows, range) on the
+	 *				calling thread as they arrive, returning false stops the scan. sync_snapshots starts the
+	 *				snapshots under FLUSH TABLES WITH READ LOCK so every range sees the same point in time.
+	 *				Batches page on the key alone, it must be unique or rows sharing a batch's last key are skipped.
+	 */
+	MariaDBConnector::ErrorCode scan_ranges(const String &p_table,
+			const String &p_key_column,
+			const Callable &p_on_chunk,
+			const String &p_columns = "*",
+			const String &p_where = "",
+			const int p_chunk_rows = 1000,
+			const int p_connections = -1,
+			const bool p_sync_snapshots = false);
+	/**
+	 * \brief		Error of the public call that finished last, on whichever thread made it.
+	 */
+	MariaDBConnector::ErrorCode get_last_error() const { return _last_error; }
+
+	/**
+	 * \brief		Share of the queued dispatch a class gets relative to the others, defaults 8, 4 and 1.
+	 */
+	void set_priority_weight(const Priority p_priority, const int p_weight);
+	int get_priority_weight(const Priority p_priority) const;
+	/**
+	 * \brief		Per class Dictionaries keyed "critical", "normal" and "background" with "admitted", "rejected",
+	 *				"timed_out" and "waiting" counts.
+	 */
+	Dictionary get_admission_stats();
+
+	/**
+	 * \brief		A replica safe select_query or select_template that is identical, params included, to one already
+	 *				running waits for that one instead of going to the server, each caller gets its own deep copy.
+	 */
+	void set_coalesce_reads(const bool p_enable) { _coalesce_reads = p_enable; }
+	bool is_coalesce_reads() const { return _coalesce_reads; }
+	/**
+	 * \brief		Released connections get reset_session so no session state leaks to the next caller.
+	 */
+	void set_reset_on_release(const bool p_enable) { _reset_on_release = p_enable; }
+	bool is_reset_on_release() const { return _reset_on_release; }
+	/**
+	 * \brief		Number of reads served from another caller's in-flight result.
+	 */
+	int64_t get_coalesced_count() const { return _coalesced; }
+
+	/**
+	 * \brief		With the monitor running, idle connections unused for keepalive_interval msec, capped at half the
+	 *				server's wait_timeout, are pinged in the background. A dead one is replaced by a new
+	 *				connection to its node. 0 disables the pings.
+	 */
+	void set_keepalive_interval(const int p_msec);
+	int get_keepalive_interval() const { return _keepalive_msec; }
+	/**
+	 * \brief		Idle connections unused this long are closed by the monitor, 0 keeps them.
+	 */
+	void set_max_idle_time(const int p_msec);
+	int get_max_idle_time() const { return _max_idle_msec; }
+	/**
+	 * \brief		"pinged", "dead" and "reaped" idle connection counts of the monitor.
+	 */
+	Dictionary get_keepalive_stats();
+
+	void start_monitor(const int p_interval_msec = 1000);
+	void stop_monitor();
+	bool is_monitoring() const { return _monitor_thread.joinable(); }
+	/**
+	 * \brief		Stops the monitor and disconnects every idle connection, leased ones are closed on release.
+	 */
+	void close();
+
+	MariaDBConnectionPool();
+	~MariaDBConnectionPool();
+
+protected:
+	static void _bind_methods();
+
+private:
+	struct Node {
+		Ref<MariaDBConnectContext> context;
+		// Used by the monitor thread only
+		Ref<MariaDBConnector> monitor;
+		int wsrep_state = -1;
+		bool wsrep_ready = true;
+		bool synced = true;
+		// Set after a failed connect so callers don't retry a dead node on every acquire
+		uint64_t down_until_msec = 0;
+		// @@wait_timeout read by the monitor, 0 until known
+		uint64_t wait_timeout_msec = 0;
+		int open = 0;
+	};
+
+	struct Pooled {
+		Ref<MariaDBConnector> conn;
+		int node = -1;
+		uint64_t leased_usec = 0;
+		// Returned to idle or last pinged
+		uint64_t idle_since_msec = 0;
+	};
+
+	// Stride scheduling, the queued class with the lowest pass is served next and advances by kStride / weight
+	struct PriorityClass {
+		int weight = 1;
+		uint64_t pass = 0;
+		std::deque<uint64_t> waiters;
+		uint64_t admitted = 0;
+		uint64_t rejected = 0;
+		uint64_t timed_out = 0;
+	};
+
+	enum LeaseResult {
+		LEASE_NONE,
+		LEASE_IDLE,
+		LEASE_SLOT,
+	};
+
+	// A coalesced read, the caller that started it runs it and publishes the rows to the followers
+	struct Flight {
+		bool done = false;
+		int followers = 0;
+		TypedArray<Dictionary> rows;
+		MariaDBConnector::ErrorCode error = MariaDBConnector::OK;
+	};
+
+	struct ParallelJob {
+		MariaDBConnectionPool *pool = nullptr;
+		Priority priority = PRIORITY_NORMAL;
+		std::vector<String> sql;
+		std::vector<Ref<MariaDBQueryTemplate>> templates;
+		std::vector<Array> params;
+		// Written by the task that owns the index only
+		std::vector<Variant> results;
+		std::vector<MariaDBConnector::ErrorCode> errors;
+	};
+
+	struct ScanJob {
+		// "SELECT columns FROM table WHERE (where) AND ", the key range is appended per batch
+		String select_head;
+		String key_sql;
+		String key_name;
+		int chunk_rows = 0;
+		std::vector<Ref<MariaDBConnector>> conns;
+		// Inclusive key bounds, one task per range
+		std::vector<std::pair<int64_t, int64_t>> ranges;
+
+		std::mutex mutex;
+		std::condition_variable cv;
+		// Scanned chunks waiting for the caller, bounded so a slow callback holds back the tasks
+		std::deque<std::pair<int, TypedArray<Dictionary>>> chunks;
+		size_t max_chunks = 0;
+		size_t finished = 0;
+		bool cancel = false;
+		MariaDBConnector::ErrorCode error = MariaDBConnector::OK;
+	};
+
+	struct WarmUpJob {
+		MariaDBConnectionPool *pool = nullptr;
+		// Reserved slot per connect, node index and its context
+		std::vector<std::pair<int, Ref<MariaDBConnectContext>>> slots;
+		double connects_per_sec = 0.0;
+		uint64_t start_usec = 0;
+		std::atomic<int> opened{ 0 };
+		std::atomic<int> failed{ 0 };
+	};
+
+	std::mutex _mutex;
+	std::condition_variable _released_cv;
+	std::vector<Node> _nodes;
+	std::vector<Pooled> _idle;
+	std::vector<Pooled> _leased;
+	int _max_size = 8;
+	int _open = 0;
+	int _acquire_timeout_msec = 5000;
+	bool _pin_writes = false;
+	bool _closed = false;
+	bool _reset_on_release = true;
+	PriorityClass _classes[PRIORITY_MAX];
+	uint64_t _next_waiter_id = 0;
+	uint64_t _virtual_pass = 0;
+	// Moving average of how long a connection stays leased, drives the wait estimate
+	double _lease_usec_avg = 0.0;
+	int _keepalive_msec = 30000;
+	int _max_idle_msec = 0;
+	uint64_t _pinged = 0;
+	uint64_t _dead = 0;
+	uint64_t _reaped = 0;
+	// Only written by public calls on the calling thread, atomic since several threads share the pool
+	std::atomic<MariaDBConnector::ErrorCode> _last_error{ MariaDBConnector::OK };
+
+	std::thread _monitor_thread;
+	std::mutex _monitor_mutex;
+	std::condition_variable _monitor_cv;
+	bool _monitor_stop = false;
+	int _monitor_interval_msec = 1000;
+
+	bool _coalesce_reads = false;
+	std::atomic<int64_t> _coalesced{ 0 };
+	std::mutex _flight_mutex;
+	std::condition_variable _flight_cv;
+	// Keyed by the SQL as sent, templates rendered with their params
+	HashMap<String, std::shared_ptr<Flight>> _flights;
+
+	std::thread _warm_up_thread;
+	std::atomic<bool> _warming_up{ false };
+
+	bool _node_usable(const Node &p_node, const uint64_t p_now_msec) const;
+	int _writer_node(const uint64_t p_now_msec) const;
+	int _pick_node(const bool p_for_write, const uint64_t p_now_msec) const;
+	Ref<MariaDBConnector> _open_connection(const Ref<MariaDBConnectContext> &p_context,
+			MariaDBConnector::ErrorCode &r_error);
+	// acquire without touching _last_error, for workers and for public calls that report their own error
+	Ref<MariaDBConnector> _acquire(const bool p_for_write,
+			const Priority p_priority,
+			const int p_timeout_msec,
+			MariaDBConnector::ErrorCode &r_error);
+	LeaseResult _try_lease(const bool p_for_write, const uint64_t p_now_msec, Pooled &r_pooled);
+	void _close_pooled(const Pooled &p_pooled);
+	int _next_class() const;
+	bool _has_waiters() const;
+	uint64_t _estimate_wait_msec(const Priority p_priority) const;
+	void _monitor_loop();
+	uint64_t _keepalive_due_msec(const Node &p_node) const;
+	void _maintain_idle();
+	void _add_warmed(const int p_node, const Ref<MariaDBConnector> &p_conn);
+	static void _warm_up_task(void *p_userdata, uint32_t p_index);
+	static void _parallel_task(void *p_userdata, uint32_t p_index);
+	static void _scan_task(void *p_userdata, uint32_t p_index);
+	void _check_node(const int p_node);
+	Variant _run(const String &p_sql,
+			const bool p_select,
+			const Priority p_priority,
+			MariaDBConnector::ErrorCode &r_error,
+			const Ref<MariaDBQueryTemplate> &p_template = Ref<MariaDBQueryTemplate>(),
+			const Array &p_params = Array());
+	TypedArray<Dictionary> _select(const String &p_sql,
+			const Priority p_priority,
+			MariaDBConnector::ErrorCode &r_error,
+			const Ref<MariaDBQueryTemplate> &p_template = Ref<MariaDBQueryTemplate>(),
+			const Array &p_params = Array());
+};
+
+VARIANT_ENUM_CAST(MariaDBConnectionPool::Priority);
@@ -31,19 +31,63 @@
 
 #include "mariadb_connector.hpp"
 
-#include "ed25519_ref10/ed25519_auth.h"
 #include "mariadb_conversions.hpp"
+#include "mariadb_dns_cache.hpp"
+#include "mbedtls/ctr_drbg.h"
+#include "mbedtls/entropy.h"
+#include "mbedtls/pk.h"
+#include "mbedtls/rsa.h"
 #include "mbedtls/sha1.h"
-#include "mbedtls/sha512.h"
+#include "mbedtls/sha256.h"
 
-#include <godot_cpp/classes/marshalls.hpp>
 #include <godot_cpp/classes/os.hpp>
 #include <godot_cpp/classes/time.hpp>
 #include <godot_cpp/core/memory.hpp>
 #include <godot_cpp/variant/utility_functions.hpp>
 
+#include <mutex>
+#include <vector>
+
 using namespace godot;
 
+// Adds last_gtid to the session variables reported in the OK packet, it changes on each committed write
+static constexpr const char* kTrackGtidStmt =
+		"SET SESSION session_track_system_variables = "
+		"CONCAT_WS(',', @@session.session_track_system_variables, 'last_gtid')";
+
+// ER_STATEMENT_TIMEOUT from max_statement_time and ER_QUERY_INTERRUPTED from KILL QUERY
+static constexpr uint16_t kErStatementTimeout = 1969;
+static constexpr uint16_t kErQueryInterrupted = 1317;
+// Past a deadline the server gets this long to report max_statement_time before the query is killed
+static constexpr uint64_t kDeadlineGraceMsec = 100;
+// The kill and the interrupted statement's reply have to fit in this much after the deadline, the connector
+// stays locked meanwhile
+static constexpr uint64_t kDeadlineKillMsec = 1000;
+
+// Process wide token bucket for automatic reconnects, a server restart would otherwise be met by every
+// connection at the same moment.
+static std::mutex s_reconnect_rate_mutex;
+static double s_reconnect_per_sec = 100.0;
+static double s_reconnect_burst = 20.0;
+static double s_reconnect_tokens = 20.0;
+static uint64_t s_reconnect_refill_usec = 0;
+
+static bool _take_reconnect_token() {
+	std::lock_guard<std::mutex> lock(s_reconnect_rate_mutex);
+	if (s_reconnect_per_sec <= 0.0) return true;
+
+	const uint64_t now_usec = Time::get_singleton()->get_ticks_usec();
+	if (s_reconnect_refill_usec != 0) {
+		s_reconnect_tokens += (now_usec - s_reconnect_refill_usec) * s_reconnect_per_sec / 1000000.0;
+		if (s_reconnect_tokens > s_reconnect_burst) s_reconnect_tokens = s_reconnect_burst;
+	}
+	s_reconnect_refill_usec = now_usec;
+
+	if (s_reconnect_tokens < 1.0) return false;
+	s_reconnect_tokens -= 1.0;
+	return true;
+}
+
 static uint64_t _decode_lenenc_adv_itr(const PackedByteArray& p_buf, size_t& p_pkt_idx) {
 	uint8_t marker = p_buf[p_pkt_idx++];
 	if (marker < 0xFB) {
@@ -103,6 +147,20 @@ static inline PackedByteArray _sha1(const PackedByteArray& p_data) {
 	return output;
 }
 
+static inline PackedByteArray _sha256(const PackedByteArray& p_data) {
+	PackedByteArray output;
+	output.resize(32);
+
+	mbedtls_sha256_context ctx;
+	mbedtls_sha256_init(&ctx);
+	mbedtls_sha256_starts(&ctx, 0);
+	mbedtls_sha256_update(&ctx, p_data.ptr(), p_data.size());
+	mbedtls_sha256_finish(&ctx, output.ptrw());
+	mbedtls_sha256_free(&ctx);
+
+	return output;
+}
+
 MariaDBConnector::MariaDBConnector() {
 	_stream.instantiate();
 	_stream_mutex = memnew(Mutex);
@@ -129,15 +187,37 @@ void MariaDBConnector::_bind_methods() {
 								D_METHOD("connection_instance", "mariadb_connect_context"),
 								&MariaDBConnector::connection_instance);
 	ClassDB::bind_method(D_METHOD("disconnect_db"), &MariaDBConnector::disconnect_db);
-	ClassDB::bind_method(D_METHOD("execute_command", "sql_stmt"), &MariaDBConnector::excecute_command);
+	ClassDB::bind_method(
+			D_METHOD("change_user", "username", "password", "database", "authtype", "is_prehashed"),
+			&MariaDBConnector::change_user,
+			DEFVAL(AUTH_TYPE_ED25519),
+			DEFVAL(true));
+	ClassDB::bind_method(D_METHOD("reset_session"), &MariaDBConnector::reset_session);
+	ClassDB::bind_method(D_METHOD("get_connect_stats"), &MariaDBConnector::get_connect_stats);
+	ClassDB::bind_method(D_METHOD("set_track_gtid", "enable"), &MariaDBConnector::set_track_gtid);
+	ClassDB::bind_method(D_METHOD("is_track_gtid"), &MariaDBConnector::is_track_gtid);
+	ClassDB::bind_method(D_METHOD("get_last_gtid"), &MariaDBConnector::get_last_gtid);
+	ClassDB::bind_method(D_METHOD("get_client_ed25519_signature", "sha512_hashed_passwd", "svr_msg"),
+						 &MariaDBConnector::get_client_ed25519_signature);
+	ClassDB::bind_static_method(
+			"MariaDBConnector", D_METHOD("get_ed25519_backend"), &MariaDBConnector::get_ed25519_backend);
+	ClassDB::bind_method(D_METHOD("execute_command", "sql_stmt", "deadline_msec"),
+						 &MariaDBConnector::excecute_command,
+						 DEFVAL(0));
 	ClassDB::bind_method(D_METHOD("get_last_query_converted"), &MariaDBConnector::get_last_query_converted);
 	ClassDB::bind_method(D_METHOD("get_last_response"), &MariaDBConnector::get_last_response);
 	ClassDB::bind_method(D_METHOD("get_last_transmitted"), &MariaDBConnector::get_last_transmitted);
 	ClassDB::bind_method(D_METHOD("get_last_error"), &MariaDBConnector::get_last_error);
 	ClassDB::bind_method(D_METHOD("get_last_error_code"), &MariaDBConnector::get_last_error);
 	ClassDB::bind_method(D_METHOD("is_connected_db"), &MariaDBConnector::is_connected_db);
-	ClassDB::bind_method(D_METHOD("select_query", "sql_stmt"), &MariaDBConnector::select_query);
-	ClassDB::bind_method(D_METHOD("query", "sql_stmt"), &MariaDBConnector::query);
+	ClassDB::bind_method(D_METHOD("is_in_transaction"), &MariaDBConnector::is_in_transaction);
+	ClassDB::bind_method(
+			D_METHOD("select_query", "sql_stmt", "deadline_msec"), &MariaDBConnector::select_query, DEFVAL(0));
+	ClassDB::bind_method(D_METHOD("query_template", "template", "params"), &MariaDBConnector::query_template);
+	ClassDB::bind_method(D_METHOD("select_template", "template", "params"), &MariaDBConnector::select_template);
+	ClassDB::bind_method(D_METHOD("execute_template", "template", "params"), &MariaDBConnector::execute_template);
+	ClassDB::bind_method(D_METHOD("query", "sql_stmt", "deadline_msec"), &MariaDBConnector::query, DEFVAL(0));
+	ClassDB::bind_method(D_METHOD("get_connection_id"), &MariaDBConnector::get_connection_id);
 	ClassDB::bind_method(D_METHOD("ping_srvr"), &MariaDBConnector::ping_srvr);
 
 	ClassDB::bind_method(D_METHOD("prep_stmt", "sql"), &MariaDBConnector::prepared_statement);
@@ -146,11 +226,40 @@ void MariaDBConnector::_bind_methods() {
 	ClassDB::bind_method(D_METHOD("prep_stmt_exec_cmd", "stmt_id", "params"),
 						 &MariaDBConnector::prepared_stmt_exec_cmd);
 	ClassDB::bind_method(D_METHOD("prep_stmt_close", "stmt_id"), &MariaDBConnector::prepared_statement_close);
+	ClassDB::bind_method(D_METHOD("prepare_and_execute", "sql", "params", "close"),
+						 &MariaDBConnector::prepare_and_execute,
+						 DEFVAL(Array()),
+						 DEFVAL(true));
 
 	ClassDB::bind_method(D_METHOD("set_dbl_to_string", "is_to_str"), &MariaDBConnector::set_dbl_to_string);
 	ClassDB::bind_method(D_METHOD("set_db_name", "db_name"), &MariaDBConnector::set_db_name);
+	ClassDB::bind_method(D_METHOD("get_db_name"), &MariaDBConnector::get_db_name);
+	ClassDB::bind_method(D_METHOD("set_init_statements", "statements"), &MariaDBConnector::set_init_statements);
+	ClassDB::bind_method(D_METHOD("get_init_statements"), &MariaDBConnector::get_init_statements);
 	ClassDB::bind_method(D_METHOD("set_ip_type", "type"), &MariaDBConnector::set_ip_type);
 	ClassDB::bind_method(D_METHOD("set_server_timeout", "msec"), &MariaDBConnector::set_server_timeout, DEFVAL(1000));
+	ClassDB::bind_method(
+			D_METHOD("set_connect_timeout", "msec"), &MariaDBConnector::set_connect_timeout, DEFVAL(1000));
+	ClassDB::bind_method(D_METHOD("set_auto_reconnect", "enable", "base_msec", "max_msec"),
+						 &MariaDBConnector::set_auto_reconnect,
+						 DEFVAL(100),
+						 DEFVAL(10000));
+	ClassDB::bind_method(D_METHOD("is_auto_reconnect"), &MariaDBConnector::is_auto_reconnect);
+	ClassDB::bind_static_method("MariaDBConnector",
+								D_METHOD("set_reconnect_rate_limit", "per_sec", "burst"),
+								&MariaDBConnector::set_reconnect_rate_limit,
+								DEFVAL(100.0),
+								DEFVAL(20));
+	ClassDB::bind_static_method("MariaDBConnector",
+								D_METHOD("set_dns_cache_ttl", "ttl_sec", "stale_sec"),
+								&MariaDBConnector::set_dns_cache_ttl,
+								DEFVAL(60),
+								DEFVAL(300));
+	ClassDB::bind_static_method("MariaDBConnector",
+								D_METHOD("prefetch_hostname", "hostname", "ip_type"),
+								&MariaDBConnector::prefetch_hostname,
+								DEFVAL(IP_TYPE_ANY));
+	ClassDB::bind_static_method("MariaDBConnector", D_METHOD("clear_dns_cache"), &MariaDBConnector::clear_dns_cache);
 
 	ADD_PROPERTY(PropertyInfo(Variant::INT, "is_connected_db"), "", "is_connected_db");
 	ADD_PROPERTY(PropertyInfo(Variant::INT, "last_error"), "", "get_last_error_code");
@@ -161,6 +270,7 @@ void MariaDBConnector::_bind_methods() {
 
 	BIND_ENUM_CONSTANT(AUTH_TYPE_ED25519);
 	BIND_ENUM_CONSTANT(AUTH_TYPE_MYSQL_NATIVE);
+	BIND_ENUM_CONSTANT(AUTH_TYPE_CACHING_SHA2);
 
 	BIND_ENUM_CONSTANT(OK);
 	BIND_ENUM_CONSTANT(ERR_NO_RESPONSE);
@@ -187,6 +297,7 @@ void MariaDBConnector::_bind_methods() {
 	BIND_ENUM_CONSTANT(ERR_UNKNOWN);
 	BIND_ENUM_CONSTANT(ERR_PACKET);
 	BIND_ENUM_CONSTANT(ERR_PREPARE_FAILED);
+	BIND_ENUM_CONSTANT(ERR_DEADLINE_EXCEEDED);
 
 	BIND_ENUM_CONSTANT(FT_TINYINT);
 	BIND_ENUM_CONSTANT(FT_TINYINT_U);
@@ -230,12 +341,19 @@ void MariaDBConnector::_add_packet_header(PackedByteArray& p_pkt, uint8_t p_pkt_
 	p_pkt = t.duplicate();
 }
 
+void MariaDBConnector::_set_packet_header(PackedByteArray& p_pkt, uint8_t p_pkt_seq) {
+	// The first 4 bytes are reserved for the header, avoids copying the payload
+	const size_t payload_len = p_pkt.size() - 4;
+	uint8_t* hdr = p_pkt.ptrw();
+	hdr[0] = payload_len & 0xFF;
+	hdr[1] = (payload_len >> 8) & 0xFF;
+	hdr[2] = (payload_len >> 16) & 0xFF;
+	hdr[3] = p_pkt_seq;
+}
+
 MariaDBConnector::ErrorCode MariaDBConnector::_client_protocol_v41(const AuthType p_srvr_auth_type,
 																   const PackedByteArray p_srvr_salt) {
-	PackedByteArray srvr_response_pba;
-	PackedByteArray srvr_auth_msg_pba;
 	uint8_t seq_num = 0;
-	AuthType user_auth_type = AUTH_TYPE_ED25519;
 
 	// Per https://mariadb.com/kb/en/connection/#handshake-response-packet
 	// int<4> client capabilities
@@ -317,26 +435,13 @@ MariaDBConnector::ErrorCode MariaDBConnector::_client_protocol_v41(const AuthTyp
 	send_buffer_pba.append_array(_username);
 	send_buffer_pba.push_back(0);  // NUL terminated
 
+	// The client's plugin is named up front, the server continues with it when it matches the user's plugin
+	// instead of sending an auth switch. The native and sha2 scrambles use the handshake salt, client_ed25519
+	// signs a nonce the server sends next, so its auth data is empty here.
+	_auth_plugin = _client_auth_type;
 	PackedByteArray auth_response_pba;
-	if (p_srvr_auth_type == AUTH_TYPE_MYSQL_NATIVE && (_client_auth_type == AUTH_TYPE_MYSQL_NATIVE)) {
-		auth_response_pba = get_mysql_native_password_hash(_password_hashed, p_srvr_salt);
-	}
-
-	// if (server_capabilities & PLUGIN_AUTH_LENENC_CLIENT_DATA)
-	// string<lenenc> authentication data
-	// else if (server_capabilities & SECURE_CONNECTION) //mysql uses secure
-	// connection flag for transactions
-	if (!(_server_capabilities & (uint64_t)Capabilities::CLIENT_MYSQL) &&
-		(_server_capabilities & (uint64_t)Capabilities::SECURE_CONNECTION)) {
-		// int<1> length of authentication response
-		send_buffer_pba.push_back((uint8_t)auth_response_pba.size());
-		// string<fix> authentication response
-		send_buffer_pba.append_array(auth_response_pba);
-	} else {
-		// else string<NUL> authentication response null ended
-		send_buffer_pba.append_array(auth_response_pba);
-		send_buffer_pba.push_back(0);  // NUL terminated
-	}
+	if (_auth_plugin != AUTH_TYPE_ED25519) auth_response_pba = _auth_plugin_data(_auth_plugin, p_srvr_salt);
+	_append_auth_data(send_buffer_pba, auth_response_pba);
 
 	// if (server_capabilities & CLIENT_CONNECT_WITH_DB)
 	// string<NUL> default database name
@@ -347,7 +452,7 @@ MariaDBConnector::ErrorCode MariaDBConnector::_client_protocol_v41(const AuthTyp
 
 	// if (server_capabilities & CLIENT_PLUGIN_AUTH)
 	// string<NUL> authentication plugin name
-	PackedByteArray auth_plugin_name_pba = kAuthTypeNames[(size_t)AUTH_TYPE_MYSQL_NATIVE].to_ascii_buffer();
+	PackedByteArray auth_plugin_name_pba = kAuthTypeNames[(size_t)_auth_plugin].to_ascii_buffer();
 	send_buffer_pba.append_array(auth_plugin_name_pba);
 	send_buffer_pba.push_back(0);  // NUL terminated
 
@@ -357,70 +462,223 @@ MariaDBConnector::ErrorCode MariaDBConnector::_client_protocol_v41(const AuthTyp
 	// packet has remaining data string<lenenc> key string<lenenc> value
 
 	_add_packet_header(send_buffer_pba, ++seq_num);
+	_auth_round_trips = 1;
 	_last_error = (ErrorCode)_stream->put_data(send_buffer_pba);
 	if (_last_error != OK) return _last_error;
 
-	srvr_response_pba = _read_buffer(_server_timout_msec);
-	size_t itr = 4;
+	PackedByteArray srvr_response_pba = _read_buffer(_server_timout_msec);
+	return _auth_response(srvr_response_pba);
+}
+
+MariaDBConnector::ErrorCode MariaDBConnector::_auth_response(const PackedByteArray& p_srvr_response) {
+	// Handles the server reply to a handshake response or COM_CHANGE_USER, auth switch requests and plugin
+	// exchanges are answered until the final OK/ERR packet.
+	_authenticated = false;
+	PackedByteArray rx_bfr = p_srvr_response;
+	size_t pkt_idx = 0;
+	PackedByteArray nonce = _srvr_salt.slice(0, 20);
+	// The init statements are pipelined behind the last auth packet, their results follow the OK packet
+	bool init_sent = false;
+	bool ed25519_signed = false;
+	int bfr_size = 0;
+
+	while (true) {
+		if (_rcv_bfr_chk(rx_bfr, bfr_size, pkt_idx, 5) != OK) {
+			ERR_PRINT("Authentication: no response from server!");
+			return ErrorCode::ERR_NO_RESPONSE;
+		}
+		size_t pkt_len = bytes_to_num_adv_itr<size_t>(rx_bfr.ptr(), 3, pkt_idx);
+		uint8_t seq_num = rx_bfr[pkt_idx++];
+		if (_rcv_bfr_chk(rx_bfr, bfr_size, pkt_idx, pkt_len) != OK) {
+			ERR_PRINT("Authentication: incomplete response from server!");
+			return ErrorCode::ERR_PACKET_LENGTH_MISMATCH;
+		}
+		const size_t pkt_end = pkt_idx + pkt_len;
+		uint8_t status = rx_bfr[pkt_idx];
+
+		// The server escapes a leading 0x01, 0xFE or 0xFF of the nonce with 0x01, one starting with 0x00 is sent raw
+		const bool awaiting_nonce = _auth_plugin == AUTH_TYPE_ED25519 && !ed25519_signed;
+		const bool raw_nonce = pkt_len == 32 && status != 0x01 && status != 0xFE && status != 0xFF;
+		if (awaiting_nonce && (raw_nonce || (pkt_len == 33 && status == 0x01))) {
+			// client_ed25519 was named in the handshake and the server sent its 32 byte nonce directly,
+			// raw or escaped with 0x01 when the first byte could be read as a status.
+			PackedByteArray ed_nonce = rx_bfr.slice(pkt_end - 32, pkt_end);
+			PackedByteArray send_buffer_pba = _auth_plugin_data(AUTH_TYPE_ED25519, ed_nonce);
+			ed25519_signed = true;
+			_add_packet_header(send_buffer_pba, ++seq_num);
+			if (!_init_stmt_pkt.is_empty()) {
+				send_buffer_pba.append_array(_init_stmt_pkt);
+				init_sent = true;
+			}
+			_auth_round_trips++;
+			_last_error = (ErrorCode)_stream->put_data(send_buffer_pba);
+			if (_last_error != OK) {
+				ERR_PRINT("Failed to put data!");
+				return _last_error;
+			}
+			rx_bfr = _read_buffer(_server_timout_msec);
+			pkt_idx = 0;
+			continue;
+		}
 
-	if (srvr_response_pba.size() > 0) {
-		// 4th byte is seq should be 2
-		seq_num = srvr_response_pba[3];
-		// 5th byte is status
-		uint8_t status = srvr_response_pba[itr];
 		if (status == 0x00) {
+			// client_ed25519 only authenticates once the nonce is signed
+			if (awaiting_nonce) {
+				ERR_PRINT("Authentication: OK packet before the client_ed25519 signature was sent!");
+				return ErrorCode::ERR_AUTH_PROTOCOL_MISMATCH;
+			}
 			_authenticated = true;
-			return ErrorCode::OK;
-		} else if (status == 0xFE) {
-			user_auth_type = _get_server_auth_type(_parse_null_utf8_at_adv_idx(srvr_response_pba, itr));
+			if (!init_sent) return _init_stmts_send();
+			size_t init_idx = pkt_end;
+			return _init_stmts_response(rx_bfr, init_idx);
 		} else if (status == 0xFF) {
-			_handle_server_error(srvr_response_pba, itr);
-			_authenticated = false;
+			_handle_server_error(rx_bfr, ++pkt_idx);
 			return ErrorCode::ERR_AUTH_FAILED;
+		}
+
+		PackedByteArray send_buffer_pba;
+		bool last_auth_pkt = true;
+		if (status == 0xFE) {
+			// Auth switch request, string<NUL> plugin name followed by the plugin data, pkt_idx is left at the NUL
+			_auth_plugin = _get_server_auth_type(_parse_null_utf8_at_adv_idx(rx_bfr, pkt_idx));
+			nonce = rx_bfr.slice(pkt_idx + 1, pkt_end);
+			// The scramble is NUL terminated for the native and sha2 plugins
+			if (_auth_plugin != AUTH_TYPE_ED25519 && nonce.size() > 20) nonce.resize(20);
+			if (_auth_plugin != _client_auth_type) return ErrorCode::ERR_AUTH_PROTOCOL_MISMATCH;
+			send_buffer_pba = _auth_plugin_data(_auth_plugin, nonce);
+			ed25519_signed = _auth_plugin == AUTH_TYPE_ED25519;
+			// caching_sha2_password can still ask for the full authentication
+			last_auth_pkt = _auth_plugin != AUTH_TYPE_CACHING_SHA2;
+		} else if (status == 0x01 && _auth_plugin == AUTH_TYPE_CACHING_SHA2) {
+			// Per https://dev.mysql.com/doc/dev/mysql-server/latest/page_caching_sha2_authentication_exchanges.html
+			if (pkt_len == 2 && rx_bfr[pkt_idx + 1] == 0x03) {
+				// Fast auth succeeded, the OK packet follows
+				pkt_idx = pkt_end;
+				continue;
+			}
+			if (pkt_len == 2 && rx_bfr[pkt_idx + 1] == 0x04) {
+				// Full auth, the server has no cached credential. Without TLS the password is sent RSA encrypted.
+				if (_password_plain.is_empty()) {
+					ERR_PRINT("caching_sha2_password full authentication needs the plain text password, the server "
+							  "has no cached credential for a prehashed password.");
+					return ErrorCode::ERR_AUTH_FAILED;
+				}
+				if (_srvr_public_key.is_empty()) {
+					send_buffer_pba.push_back(0x02);  // request public key
+					last_auth_pkt = false;
+				} else {
+					send_buffer_pba = _caching_sha2_encrypt_password(_srvr_public_key, nonce);
+				}
+			} else {
+				// Public key in PEM format
+				_srvr_public_key = rx_bfr.slice(pkt_idx + 1, pkt_end);
+				send_buffer_pba = _caching_sha2_encrypt_password(_srvr_public_key, nonce);
+			}
+			if (send_buffer_pba.is_empty()) return ErrorCode::ERR_AUTH_FAILED;
 		} else {
-			ERR_FAIL_V_EDMSG(ErrorCode::ERR_UNKNOWN,
-							 "Unhandled response code:" + String::num_uint64(srvr_response_pba[itr], 16, true));
+			ERR_FAIL_V_EDMSG(ErrorCode::ERR_UNKNOWN, "Unhandled response code:" + String::num_uint64(status, 16, true));
 		}
-	}
 
-	if (user_auth_type == AUTH_TYPE_ED25519 && _client_auth_type == AUTH_TYPE_ED25519) {
-		// srvr_auth_msg.assign(srvr_response.begin() + itr + 1,
-		// srvr_response.end());
-		srvr_auth_msg_pba.append_array(srvr_response_pba.slice(itr + 1));
-		auth_response_pba = get_client_ed25519_signature(_password_hashed, srvr_auth_msg_pba);
-		send_buffer_pba = auth_response_pba;
-	} else {
-		return ErrorCode::ERR_AUTH_PROTOCOL_MISMATCH;
-	}
+		_add_packet_header(send_buffer_pba, ++seq_num);
+		// If auth fails the server drops the connection without executing the pipelined init statements.
+		if (last_auth_pkt && !_init_stmt_pkt.is_empty()) {
+			send_buffer_pba.append_array(_init_stmt_pkt);
+			init_sent = true;
+		}
 
-	_add_packet_header(send_buffer_pba, ++seq_num);
+		_auth_round_trips++;
+		_last_error = (ErrorCode)_stream->put_data(send_buffer_pba);
+		if (_last_error != OK) {
+			ERR_PRINT("Failed to put data!");
+			return _last_error;
+		}
 
-	_last_error = (ErrorCode)_stream->put_data(send_buffer_pba);
-	if (_last_error != OK) {
-		ERR_PRINT("Failed to put data!");
-		return _last_error;
+		rx_bfr = _read_buffer(_server_timout_msec);
+		pkt_idx = 0;
 	}
+}
 
-	srvr_response_pba = _read_buffer(_server_timout_msec);
+PackedByteArray MariaDBConnector::_auth_plugin_data(const AuthType p_plugin, const PackedByteArray& p_nonce) {
+	// The credential only fits the plugin it was hashed for
+	if (p_plugin != _client_auth_type) return PackedByteArray();
+
+	switch (p_plugin) {
+		case AUTH_TYPE_ED25519:
+			if (!_ed25519_cred || p_nonce.size() < 32) return PackedByteArray();
+			return _ed25519_cred->sign(p_nonce.slice(0, 32));
+		case AUTH_TYPE_MYSQL_NATIVE:
+			return get_mysql_native_password_hash(_password_hashed, p_nonce);
+		case AUTH_TYPE_CACHING_SHA2:
+			return get_caching_sha2_passwd_hash(_password_hashed, p_nonce);
+		default:
+			return PackedByteArray();
+	}
+}
 
-	if (srvr_response_pba.size() > 0) {
-		// 4th byte is seq should be 2
-		seq_num = srvr_response_pba[3];
-		// 5th byte is status
-		itr = 4;
-		if (srvr_response_pba[itr] == 0x00) {
-			_authenticated = true;
-		} else if (srvr_response_pba[itr] == 0xFF) {
-			_handle_server_error(srvr_response_pba, itr);
-			_authenticated = false;
-			return ErrorCode::ERR_AUTH_FAILED;
-		} else {
-			ERR_FAIL_V_MSG(ErrorCode::ERR_UNKNOWN,
-						   "Unhandled response code:" + String::num_uint64(srvr_response_pba[itr], 16, true));
-		}
+void MariaDBConnector::_append_auth_data(PackedByteArray& p_buf, const PackedByteArray& p_auth_data) {
+	// if (server_capabilities & PLUGIN_AUTH_LENENC_CLIENT_DATA)
+	// string<lenenc> authentication data
+	// else if (server_capabilities & CLIENT_SECURE_CONNECTION), RESERVED2 here, set by MariaDB and MySQL
+	if (_server_capabilities & (uint64_t)Capabilities::RESERVED2) {
+		// int<1> length of authentication response
+		p_buf.push_back((uint8_t)p_auth_data.size());
+		// string<fix> authentication response
+		p_buf.append_array(p_auth_data);
+	} else {
+		// else string<NUL> authentication response null ended
+		p_buf.append_array(p_auth_data);
+		p_buf.push_back(0);  // NUL terminated
 	}
+}
 
-	return ErrorCode::OK;
+PackedByteArray MariaDBConnector::_caching_sha2_encrypt_password(const PackedByteArray& p_public_key_pem,
+																 const PackedByteArray& p_nonce) {
+	// The NUL terminated password XOR the scramble, RSA OAEP encrypted with the server public key
+	PackedByteArray plain = _password_plain;
+	plain.push_back(0);
+	for (int64_t i = 0; i < plain.size(); ++i) {
+		plain.set(i, plain[i] ^ p_nonce[i % p_nonce.size()]);
+	}
+
+	// mbedtls needs the PEM NUL terminated, the length includes the NUL
+	PackedByteArray pem = p_public_key_pem;
+	if (pem.is_empty() || pem[pem.size() - 1] != 0) pem.push_back(0);
+
+	PackedByteArray encrypted;
+	mbedtls_pk_context pk;
+	mbedtls_entropy_context entropy;
+	mbedtls_ctr_drbg_context ctr_drbg;
+	mbedtls_pk_init(&pk);
+	mbedtls_entropy_init(&entropy);
+	mbedtls_ctr_drbg_init(&ctr_drbg);
+
+	int ret = mbedtls_pk_parse_public_key(&pk, pem.ptr(), pem.size());
+	if (ret == 0 && mbedtls_pk_get_type(&pk) != MBEDTLS_PK_RSA) ret = -1;
+	if (ret == 0) ret = mbedtls_ctr_drbg_seed(&ctr_drbg, mbedtls_entropy_func, &entropy, nullptr, 0);
+	if (ret == 0) {
+		mbedtls_rsa_set_padding(mbedtls_pk_rsa(pk), MBEDTLS_RSA_PKCS_V21, MBEDTLS_MD_SHA1);
+		encrypted.resize(mbedtls_pk_get_len(&pk));
+		size_t out_len = 0;
+		ret = mbedtls_pk_encrypt(&pk,
+								 plain.ptr(),
+								 plain.size(),
+								 encrypted.ptrw(),
+								 &out_len,
+								 encrypted.size(),
+								 mbedtls_ctr_drbg_random,
+								 &ctr_drbg);
+		encrypted.resize(out_len);
+	}
+	if (ret != 0) {
+		ERR_PRINT(vformat("caching_sha2_password RSA encryption failed, mbedtls error -0x%04x", -ret));
+		encrypted.clear();
+	}
+
+	plain.fill(0);
+	mbedtls_ctr_drbg_free(&ctr_drbg);
+	mbedtls_entropy_free(&entropy);
+	mbedtls_pk_free(&pk);
+	return encrypted;
 }
 
 Variant MariaDBConnector::_com_query_response(const bool p_is_command) {
@@ -472,29 +730,10 @@ Variant MariaDBConnector::_com_query_response(const bool p_is_command) {
 			return (uint32_t)_last_error;
 		}
 	} else if (marker == 0x00) {
+		pkt_idx++;
+		// Parsed for commands and queries alike so session state changes like USE are tracked
+		Dictionary result = _parse_ok_packet(srvr_response, pkt_idx, 4 + pkt_len);
 		if (p_is_command) {
-			pkt_idx++;
-			Dictionary result;
-
-			uint64_t affected_rows = _decode_lenenc_adv_itr(srvr_response, pkt_idx);
-			uint64_t last_insert_id = _decode_lenenc_adv_itr(srvr_response, pkt_idx);
-			uint16_t status_flags = srvr_response[pkt_idx++] | (srvr_response[pkt_idx++] << 8);
-			uint16_t warnings = srvr_response[pkt_idx++] | (srvr_response[pkt_idx++] << 8);
-
-			// Info message
-			String info_message = "";
-			if (pkt_idx + 1 < srvr_response.size()) {
-				info_message =
-						String::utf8((const char*)&srvr_response[pkt_idx + 1], srvr_response.size() - (pkt_idx + 1));
-			}
-
-			// Build dictionary
-			result["affected_rows"] = affected_rows;
-			result["last_insert_id"] = last_insert_id;
-			result["status_flags"] = status_flags;
-			result["warnings"] = warnings;
-			result["info"] = info_message;
-
 			return result;
 		}
 		return 0;
@@ -513,11 +752,26 @@ Variant MariaDBConnector::_com_query_response(const bool p_is_command) {
 	//	if not (CLIENT_DEPRECATE_EOF capability set) get EOF_Packet
 	bool dep_eof = (_client_capabilities & (uint64_t)Capabilities::CLIENT_DEPRECATE_EOF);
 	if (!dep_eof) {
-		pkt_idx += 5;  // bypass for now
+		_skip_packet(srvr_response, pkt_idx);
 	}
 
 	_last_response = PackedByteArray(srvr_response);
 	TypedArray<Dictionary> rows = _parse_string_rows(srvr_response, pkt_idx, col_data, dep_eof);
+	if (_last_error != OK) {
+		if (p_is_command) {
+			return 0;
+		} else {
+			return (uint32_t)_last_error;
+		}
+	}
+
+	Dictionary result = _parse_result_end(srvr_response, pkt_idx, dep_eof);
+	if (p_is_command) {
+		// INSERT/UPDATE/DELETE ... RETURNING, the OK values and the returned rows
+		if (!result.has("affected_rows")) result["affected_rows"] = rows.size();
+		result["rows"] = rows;
+		return result;
+	}
 
 	return Variant(rows);
 }
@@ -525,30 +779,15 @@ Variant MariaDBConnector::_com_query_response(const bool p_is_command) {
 MariaDBConnector::ErrorCode MariaDBConnector::_connect() {
 	disconnect_db();
 	_stream_mutex->lock();
-	_last_error = (ErrorCode)_stream->connect_to_host(_ip, _port);
-
+	const uint64_t start_usec = Time::get_singleton()->get_ticks_usec();
+	_auth_round_trips = 0;
+	_connect_usec = 0;
+	_last_error = _open_stream();
 	if (_last_error != ErrorCode::OK) {
-		ERR_PRINT("Cannot connect to host with IP: " + String(_ip) + " and port: " + itos(_port));
 		_stream_mutex->unlock();
 		return _last_error;
 	}
 
-	for (size_t i = 0; i < 1000; i++) {
-		_last_error = (ErrorCode)_stream->poll();
-		if (_last_error != OK) return _last_error;
-		if (_stream->get_status() == StreamPeerTCP::STATUS_CONNECTED) {
-			break;
-		} else {
-			OS::get_singleton()->delay_usec(1000);
-		}
-	}
-
-	if (_stream->get_status() != StreamPeerTCP::STATUS_CONNECTED) {
-		ERR_PRINT("TCP connection not established after polling. IP: " + String(_ip) + " Port: " + itos(_port));
-		_stream_mutex->unlock();
-		return ErrorCode::ERR_CONNECTION_ERROR;
-	}
-
 	PackedByteArray recv_buffer = _read_buffer(_server_timout_msec);
 	if (recv_buffer.size() <= 4) {
 		ERR_PRINT("connect: Receive buffer empty!");
@@ -593,7 +832,12 @@ MariaDBConnector::ErrorCode MariaDBConnector::_connect() {
 	 */
 
 	if (recv_buffer[4] == 10) {
-		_server_init_handshake_v10(recv_buffer);
+		_current_db = String();
+		_last_error = _server_init_handshake_v10(recv_buffer);
+		_connect_usec = Time::get_singleton()->get_ticks_usec() - start_usec;
+		if (_authenticated && (_client_capabilities & (uint64_t)Capabilities::CONNECT_WITH_DB)) {
+			_current_db.parse_utf8((const char*)_dbname.ptr(), _dbname.size());
+		}
 	} else {
 		ERR_PRINT("Unsupported protocol version in handshake packet!");
 		_stream_mutex->unlock();
@@ -602,10 +846,97 @@ MariaDBConnector::ErrorCode MariaDBConnector::_connect() {
 
 	// Passing as lambda so external non-static members can be accessed
 	// _tcp_thread = std::thread([this] { m_tcp_thread_func(); });
+	if (_authenticated) _reconnect_armed = true;
 	_stream_mutex->unlock();
-	return ErrorCode::OK;
+	return _last_error;
 }  // m_connect
 
+MariaDBConnector::ErrorCode MariaDBConnector::_open_stream() {
+	// TCP connect to the first endpoint that answers. Sequential strategies start the next candidate when the
+	// previous one failed or timed out, the race starts one every _race_delay_msec while earlier ones are still
+	// pending, happy eyeballs style, and keeps the first connected.
+	struct Attempt {
+		Ref<StreamPeerTCP> tcp;
+		String ip;
+		int port;
+		uint64_t started_msec;
+	};
+
+	const int endpoint_cnt = _endpoint_hosts.size();
+	PackedInt32Array order;
+	for (int i = 0; i < endpoint_cnt; i++) order.push_back(i);
+	if (_connect_strategy == MariaDBConnectContext::CONNECT_RANDOM) {
+		for (int i = endpoint_cnt - 1; i > 0; i--) {
+			const int j = (int)UtilityFunctions::randi_range(0, i);
+			const int tmp = order[i];
+			order.set(i, order[j]);
+			order.set(j, tmp);
+		}
+	}
+	const bool racing = _connect_strategy == MariaDBConnectContext::CONNECT_RACE;
+
+	// Every candidate is resolved before the first attempt, a slow resolver must not stall pending attempts.
+	// The hosts were prefetched when set, so this is normally a cache lookup.
+	for (int i = 0; i < endpoint_cnt; i++) MariaDBDnsCache::prefetch(_endpoint_hosts[i], (IP::Type)_ip_type);
+	PackedStringArray ips;
+	ips.resize(endpoint_cnt);
+	for (int i = 0; i < endpoint_cnt; i++) {
+		ips.set(i, MariaDBDnsCache::resolve(_endpoint_hosts[i], (IP::Type)_ip_type));
+	}
+
+	std::vector<Attempt> attempts;
+	ErrorCode err = ErrorCode::ERR_CONNECTION_ERROR;
+	int next = 0;
+	uint64_t next_start_msec = 0;
+	while (true) {
+		const uint64_t now_msec = Time::get_singleton()->get_ticks_msec();
+		if (next < endpoint_cnt && (attempts.empty() || (racing && now_msec >= next_start_msec))) {
+			const int idx = order[next++];
+			const String &ip = ips[idx];
+			if (!ip.is_valid_ip_address()) {
+				ERR_PRINT("Invalid hostname or IP address: " + _endpoint_hosts[idx]);
+				err = ErrorCode::ERR_INVALID_HOSTNAME;
+				continue;
+			}
+			Ref<StreamPeerTCP> tcp;
+			tcp.instantiate();
+			if (tcp->connect_to_host(ip, _endpoint_ports[idx]) != godot::OK) {
+				ERR_PRINT("Cannot connect to host with IP: " + ip + " and port: " + itos(_endpoint_ports[idx]));
+				continue;
+			}
+			attempts.push_back({ tcp, ip, _endpoint_ports[idx], now_msec });
+			next_start_msec = now_msec + _race_delay_msec;
+			continue;
+		}
+		if (attempts.empty()) break;
+
+		for (size_t i = 0; i < attempts.size(); i++) {
+			Attempt& attempt = attempts[i];
+			attempt.tcp->poll();
+			const StreamPeerTCP::Status status = attempt.tcp->get_status();
+			if (status == StreamPeerTCP::STATUS_CONNECTED) {
+				_stream = attempt.tcp;
+				_ip = attempt.ip;
+				_port = attempt.port;
+				for (size_t j = 0; j < attempts.size(); j++) {
+					if (j != i) attempts[j].tcp->disconnect_from_host();
+				}
+				return ErrorCode::OK;
+			}
+			const bool timed_out = now_msec - attempt.started_msec >= _connect_timeout_msec;
+			if (status != StreamPeerTCP::STATUS_CONNECTING || timed_out) {
+				ERR_PRINT("TCP connection not established. IP: " + attempt.ip + " Port: " + itos(attempt.port));
+				attempt.tcp->disconnect_from_host();
+				attempts.erase(attempts.begin() + i);
+				i--;
+			}
+		}
+		OS::get_singleton()->delay_usec(250);
+	}
+
+	return err;
+}
+
 Variant MariaDBConnector::_get_type_data(const int p_db_field_type,
 										 const PackedByteArray& p_data,
 										 const int p_char_set) {
@@ -649,15 +980,17 @@ MariaDBConnector::AuthType MariaDBConnector::_get_server_auth_type(String p_srvr
 		server_auth_type = AUTH_TYPE_MYSQL_NATIVE;
 	} else if (p_srvr_auth_name == "client_ed25519") {
 		server_auth_type = AUTH_TYPE_ED25519;
+	} else if (p_srvr_auth_name == "caching_sha2_password") {
+		server_auth_type = AUTH_TYPE_CACHING_SHA2;
 	}
-	// TODO(sigrudds1) Add cached_sha2 for mysql
 	return server_auth_type;
 }
 
-void MariaDBConnector::_handle_server_error(const PackedByteArray p_src_buffer, size_t& p_last_pos) {
+uint16_t MariaDBConnector::_handle_server_error(const PackedByteArray p_src_buffer, size_t& p_last_pos) {
 	// REF https://mariadb.com/kb/en/err_packet/
 	uint16_t srvr_error_code = (uint16_t)p_src_buffer[p_last_pos++];
 	srvr_error_code += (uint16_t)p_src_buffer[p_last_pos++] << 8;
+	_last_server_error = srvr_error_code;
 	String msg = String::num_uint64((uint64_t)srvr_error_code) + " - ";
 	if (srvr_error_code == 0xFFFF) {
 		// int<1> stage
@@ -679,7 +1012,95 @@ void MariaDBConnector::_handle_server_error(const PackedByteArray p_src_buffer,
 			}
 		}
 	}
-	ERR_FAIL_COND_EDMSG(srvr_error_code != OK, msg);
+	ERR_FAIL_COND_V_EDMSG(srvr_error_code != OK, srvr_error_code, msg);
+	return srvr_error_code;
+}
+
+Dictionary MariaDBConnector::_parse_ok_packet(const PackedByteArray& p_rx_bfr, size_t& p_pkt_idx, size_t p_pkt_end) {
+	// REF https://mariadb.com/kb/en/ok_packet/
+	// p_pkt_idx must be past the 0x00 (or 0xFE) header byte, it is left at p_pkt_end.
+	if (p_pkt_end > (size_t)p_rx_bfr.size()) p_pkt_end = p_rx_bfr.size();
+
+	Dictionary result;
+	uint64_t affected_rows = _decode_lenenc_adv_itr(p_rx_bfr, p_pkt_idx);
+	uint64_t last_insert_id = _decode_lenenc_adv_itr(p_rx_bfr, p_pkt_idx);
+	uint16_t status_flags = bytes_to_num_adv_itr<uint16_t>(p_rx_bfr.ptr(), 2, p_pkt_idx);
+	uint16_t warnings = bytes_to_num_adv_itr<uint16_t>(p_rx_bfr.ptr(), 2, p_pkt_idx);
+	_server_status = status_flags;
+
+	const bool session_track = (_client_capabilities & _server_capabilities & (uint64_t)Capabilities::SESSION_TRACK);
+	String info;
+	if (p_pkt_idx < p_pkt_end) {
+		if (session_track) {
+			// string<lenenc> info
+			uint64_t len = _decode_lenenc_adv_itr(p_rx_bfr, p_pkt_idx);
+			if (len != UINT64_MAX) info = vbytes_to_utf8_adv_itr(p_rx_bfr, p_pkt_idx, len);
+		} else {
+			// string<EOF> info
+			info = String::utf8((const char*)p_rx_bfr.ptr() + p_pkt_idx, p_pkt_end - p_pkt_idx);
+			p_pkt_idx = p_pkt_end;
+		}
+	}
+
+	if (session_track && (status_flags & (uint16_t)ServerStatus::SESSION_STATE_CHANGED) && p_pkt_idx < p_pkt_end) {
+		// string<lenenc> session state info, a list of int<1> type, string<lenenc> data
+		uint64_t state_len = _decode_lenenc_adv_itr(p_rx_bfr, p_pkt_idx);
+		size_t state_end = p_pkt_idx + state_len;
+		if (state_end > p_pkt_end) state_end = p_pkt_end;
+
+		while (p_pkt_idx < state_end) {
+			uint8_t type = p_rx_bfr[p_pkt_idx++];
+			uint64_t data_len = _decode_lenenc_adv_itr(p_rx_bfr, p_pkt_idx);
+			const size_t data_end = p_pkt_idx + data_len;
+			if (data_end > state_end) break;
+
+			if (type == SESSION_TRACK_SCHEMA) {
+				// string<lenenc> new current schema
+				uint64_t len = _decode_lenenc_adv_itr(p_rx_bfr, p_pkt_idx);
+				_current_db = vbytes_to_utf8_adv_itr(p_rx_bfr, p_pkt_idx, len);
+			} else if (type == SESSION_TRACK_SYSTEM_VARIABLES && _track_gtid) {
+				// string<lenenc> name, string<lenenc> value
+				uint64_t len = _decode_lenenc_adv_itr(p_rx_bfr, p_pkt_idx);
+				const String name = vbytes_to_utf8_adv_itr(p_rx_bfr, p_pkt_idx, len);
+				len = _decode_lenenc_adv_itr(p_rx_bfr, p_pkt_idx);
+				const String value = vbytes_to_utf8_adv_itr(p_rx_bfr, p_pkt_idx, len);
+				if (name == "last_gtid" && !value.is_empty()) _last_gtid = value;
+			}
+			p_pkt_idx = data_end;
+		}
+	}
+	p_pkt_idx = p_pkt_end;
+
+	result["affected_rows"] = affected_rows;
+	result["last_insert_id"] = last_insert_id;
+	result["status_flags"] = status_flags;
+	result["warnings"] = warnings;
+	result["info"] = info;
+	return result;
+}
+
+Dictionary MariaDBConnector::_parse_result_end(PackedByteArray& p_rx_bfr, size_t& p_pkt_idx, const bool p_dep_eof) {
+	// p_pkt_idx must be at the header of the EOF or OK packet ending a result set, it is left after it.
+	int bfr_size = 0;
+	_last_error = _rcv_bfr_chk(p_rx_bfr, bfr_size, p_pkt_idx, 4);
+	if (_last_error != OK) return Dictionary();
+	size_t pkt_len = bytes_to_num_adv_itr<size_t>(p_rx_bfr.ptr(), 3, p_pkt_idx);
+	p_pkt_idx++;  // seq
+	_last_error = _rcv_bfr_chk(p_rx_bfr, bfr_size, p_pkt_idx, pkt_len);
+	if (_last_error != OK) return Dictionary();
+	const size_t pkt_end = p_pkt_idx + pkt_len;
+	p_pkt_idx++;  // 0xFE
+
+	if (p_dep_eof) return _parse_ok_packet(p_rx_bfr, p_pkt_idx, pkt_end);
+
+	// EOF packet, int<2> warnings, int<2> status, it has no affected rows or insert id
+	Dictionary result;
+	uint16_t warnings = bytes_to_num_adv_itr<uint16_t>(p_rx_bfr.ptr(), 2, p_pkt_idx);
+	_server_status = bytes_to_num_adv_itr<uint16_t>(p_rx_bfr.ptr(), 2, p_pkt_idx);
+	p_pkt_idx = pkt_end;
+	result["status_flags"] = _server_status;
+	result["warnings"] = warnings;
+	return result;
 }
 
 String MariaDBConnector::_parse_null_utf8(PackedByteArray p_buf) {
@@ -732,6 +1153,7 @@ TypedArray<Dictionary> MariaDBConnector::_parse_prepared_exec(PackedByteArray& p
 			return TypedArray<Dictionary>();
 		}
 
+		const size_t pkt_start = p_pkt_idx;
 		size_t pkt_len = bytes_to_num_adv_itr<size_t>(p_rx_bfr.ptr(), 3, p_pkt_idx);
 		_last_error = _rcv_bfr_chk(p_rx_bfr, bfr_size, p_pkt_idx, pkt_len);
 		if (_last_error != OK) {
@@ -739,11 +1161,14 @@ TypedArray<Dictionary> MariaDBConnector::_parse_prepared_exec(PackedByteArray& p
 			return TypedArray<Dictionary>();
 		}
 
-		uint8_t seq_num = p_rx_bfr[p_pkt_idx++];
+		p_pkt_idx++;  // seq
+		const size_t pkt_end = p_pkt_idx + pkt_len;
 		uint8_t header_byte = p_rx_bfr[p_pkt_idx++];  // 0x00 or 0xFE
 
-		if (header_byte == 0xFE && pkt_len == 7) {
-			p_pkt_idx += pkt_len;
+		// Binary rows always start with 0x00, the result set ends with an EOF or OK packet, left for
+		// _parse_result_end
+		if (header_byte == 0xFE) {
+			p_pkt_idx = pkt_start;
 			break;
 		}
 
@@ -839,6 +1264,7 @@ TypedArray<Dictionary> MariaDBConnector::_parse_prepared_exec(PackedByteArray& p
 			row[col_name] = value;
 		}
 		rows.append(row);
+		p_pkt_idx = pkt_end;
 	}
 
 	return TypedArray<Dictionary>(rows);
@@ -854,15 +1280,15 @@ TypedArray<Dictionary> MariaDBConnector::_parse_string_rows(PackedByteArray& p_r
 	int bfr_size = 0;
 	uint64_t len_encode = 0;
 	// process values
-	while (!done && p_pkt_idx < (size_t)p_rx_bfr.size()) {
-		// Last packet (OK-Packet) is always 11 bytes, pkt len code = 3 bytes, seq = 1 byte, pkt
-		// data = 7 bytes
-		_last_error = _rcv_bfr_chk(p_rx_bfr, bfr_size, p_pkt_idx, 11);
+	// Rows are read until the EOF or OK packet ending the result set, more data is read as needed
+	while (!done) {
+		_last_error = _rcv_bfr_chk(p_rx_bfr, bfr_size, p_pkt_idx, 4);
 		if (_last_error != OK) {
-			ERR_PRINT(vformat("ERR_PACKET_LENGTH_MISMATCH rcvd %d expect %d", bfr_size, p_pkt_idx + 11));
+			ERR_PRINT(vformat("ERR_PACKET_LENGTH_MISMATCH rcvd %d expect %d", bfr_size, p_pkt_idx + 4));
 			return TypedArray<Dictionary>();
 		}
 
+		const size_t pkt_start = p_pkt_idx;
 		size_t pkt_len = bytes_to_num_adv_itr<size_t>(p_rx_bfr.ptr(), 3, p_pkt_idx);
 		_last_error = _rcv_bfr_chk(p_rx_bfr, bfr_size, p_pkt_idx, pkt_len);
 		if (_last_error != OK) {
@@ -874,7 +1300,10 @@ TypedArray<Dictionary> MariaDBConnector::_parse_string_rows(PackedByteArray& p_r
 
 		uint8_t marker = p_rx_bfr[p_pkt_idx];
 
-		if (marker == 0xFE && p_dep_eof && pkt_len < 0xFFFFFF) {
+		// A row can only start with 0xFE as an 8 byte length string, larger than an EOF packet and only
+		// larger than the OK packet when split at 0xFFFFFF. Left for _parse_result_end.
+		if (marker == 0xFE && (p_dep_eof ? pkt_len < 0xFFFFFF : pkt_len < 9)) {
+			p_pkt_idx = pkt_start;
 			done = true;
 			break;
 		}
@@ -965,17 +1394,20 @@ TypedArray<Dictionary> MariaDBConnector::_parse_string_rows(PackedByteArray& p_r
 
 	return rows;
 }
-MariaDBConnector::ErrorCode MariaDBConnector::_prepared_params_send(const uint32_t p_stmt_id,
-																	const TypedArray<Dictionary>& p_params) {
+MariaDBConnector::ErrorCode MariaDBConnector::_prepared_params_pkt(const uint32_t p_stmt_id,
+																   const Array& p_params,
+																   PackedByteArray& r_tx_buf) {
 	const int param_count = p_params.size();
-	if (_prep_column_data.has(p_stmt_id)) {
-		TypedArray<Dictionary> expected_cols = _prep_column_data[p_stmt_id];
-		if (expected_cols.size() > 0 && param_count == 0) {
-			ERR_PRINT("Expected parameter dictionary array, but received empty or invalid input.");
+	TypedArray<Dictionary> param_defs;
+	if (_prep_param_data.has(p_stmt_id)) {
+		param_defs = _prep_param_data[p_stmt_id];
+		if (param_defs.size() != param_count) {
+			ERR_PRINT(vformat("Prepared statement expects %d parameters, received %d.", param_defs.size(), param_count));
 			return ErrorCode::ERR_INVALID_PARAMETER;
 		}
 	}
-	PackedByteArray tx_buf;
+	PackedByteArray& tx_buf = r_tx_buf;
+	tx_buf.clear();
 	tx_buf.push_back(0x17);	 // COM_STMT_EXECUTE
 
 	tx_buf.push_back((p_stmt_id >> 0) & 0xFF);	// Statement ID (4 bytes)
@@ -991,30 +1423,48 @@ MariaDBConnector::ErrorCode MariaDBConnector::_prepared_params_send(const uint32
 
 	const int nullmap_size = (param_count + 7) / 8;
 	if (param_count > 0) {
-		Variant param_type = p_params[0];
-		if (param_type.get_type() != Variant::DICTIONARY) return ErrorCode::ERR_INVALID_PARAMETER;
-
 		const int nullmap_offset = tx_buf.size();
 
 		for (int i = 0; i < nullmap_size; ++i) tx_buf.push_back(0x00);	// nullmap placeholder, filled below
 
 		tx_buf.push_back(0x01);	 // new_params_bound_flag
 
+		// Types are written to tx_buf and values to val_buf in the same pass, values follow all types
+		PackedByteArray val_buf;
 		for (int i = 0; i < param_count; ++i) {
-			Variant param_type = p_params[i];
-			if (param_type.get_type() != Variant::DICTIONARY) return ErrorCode::ERR_INVALID_PARAMETER;
-
-			Dictionary param = p_params[i];
-			if (param.size() != 1) return ErrorCode::ERR_INVALID_PARAMETER;
-			Variant v = param.values()[0];
-			if (v.get_type() == Variant::NIL) {
-				int byte_i = i >> 3;
-				int bit_i = i & 7;
-				tx_buf[nullmap_offset + byte_i] |= (1 << bit_i);
+			Variant value = p_params[i];
+			FieldType field_type;
+
+			if (value.get_type() == Variant::DICTIONARY) {
+				// {FieldType: value}
+				Dictionary param = value;
+				if (param.size() != 1) return ErrorCode::ERR_INVALID_PARAMETER;
+				field_type = FieldType(uint8_t(param.keys()[0]));
+				value = param.values()[0];
+			} else if (value.get_type() == Variant::NIL) {
+				tx_buf[nullmap_offset + (i >> 3)] |= (1 << (i & 7));
+				tx_buf.push_back(MYSQL_TYPE_NULL);
+				tx_buf.push_back(SIGN_SIGNED);
+				continue;
+			} else {
+				bool is_unsigned = false;
+				if (!param_defs.is_empty()) {
+					Dictionary param_def = param_defs[i];
+					is_unsigned = int(param_def["flags"]) & 32;
+				}
+				if (!_infer_field_type(value, is_unsigned, field_type)) {
+					ERR_PRINT(vformat("Unsupported parameter type %s at index %d.",
+										  Variant::get_type_name(value.get_type()),
+										  i));
+					return ErrorCode::ERR_INVALID_PARAMETER;
+				}
 			}
 
-			uint16_t k = param.keys()[0];
-			switch (k) {
+			if (value.get_type() == Variant::NIL) {
+				tx_buf[nullmap_offset + (i >> 3)] |= (1 << (i & 7));
+			}
+
+			switch (field_type) {
 				case FT_TINYINT:
 					tx_buf.push_back(MYSQL_TYPE_TINY);
 					tx_buf.push_back(SIGN_SIGNED);
@@ -1142,28 +1592,19 @@ MariaDBConnector::ErrorCode MariaDBConnector::_prepared_params_send(const uint32
 				default:
 					return ErrorCode::ERR_INVALID_PARAMETER;
 			}
-		}
-
-		// Parameter values
-		for (int i = 0; i < param_count; ++i) {
-			Dictionary param = p_params[i];
-			FieldType field_type = FieldType(uint8_t(param.keys()[0]));
-			Variant value = param.values()[0];
 
-			if (value.get_type() == Variant::NIL) {
-				continue;
-			}
+			if (value.get_type() == Variant::NIL) continue;
 
 			switch (field_type) {
 				case FT_TINYINT:
 				case FT_TINYINT_U:
-					tx_buf.push_back(uint8_t(value));
+					val_buf.push_back(uint8_t(value));
 					break;
 				case FT_SHORT:
 				case FT_SHORT_U: {
 					uint16_t val = uint16_t(value);
-					tx_buf.push_back(val & 0xFF);
-					tx_buf.push_back((val >> 8) & 0xFF);
+					val_buf.push_back(val & 0xFF);
+					val_buf.push_back((val >> 8) & 0xFF);
 					break;
 				}
 				case FT_INT:
@@ -1171,28 +1612,28 @@ MariaDBConnector::ErrorCode MariaDBConnector::_prepared_params_send(const uint32
 				case FT_MEDIUMINT:
 				case FT_MEDIUMINT_U: {
 					uint32_t val = uint32_t(value);
-					tx_buf.push_back(val & 0xFF);
-					tx_buf.push_back((val >> 8) & 0xFF);
-					tx_buf.push_back((val >> 16) & 0xFF);
-					tx_buf.push_back((val >> 24) & 0xFF);
+					val_buf.push_back(val & 0xFF);
+					val_buf.push_back((val >> 8) & 0xFF);
+					val_buf.push_back((val >> 16) & 0xFF);
+					val_buf.push_back((val >> 24) & 0xFF);
 					break;
 				}
 				case FT_BIGINT:
 				case FT_BIGINT_U: {
 					uint64_t val = uint64_t(value);
-					for (int b = 0; b < 8; ++b) tx_buf.push_back((val >> (b * 8)) & 0xFF);
+					for (int b = 0; b < 8; ++b) val_buf.push_back((val >> (b * 8)) & 0xFF);
 					break;
 				}
 				case FT_FLOAT: {
 					float f = value;
 					const uint8_t* ptr = reinterpret_cast<const uint8_t*>(&f);
-					for (int b = 0; b < 4; ++b) tx_buf.push_back(ptr[b]);
+					for (int b = 0; b < 4; ++b) val_buf.push_back(ptr[b]);
 					break;
 				}
 				case FT_DOUBLE: {
 					double d = value;
 					const uint8_t* ptr = reinterpret_cast<const uint8_t*>(&d);
-					for (int b = 0; b < 8; ++b) tx_buf.push_back(ptr[b]);
+					for (int b = 0; b < 8; ++b) val_buf.push_back(ptr[b]);
 					break;
 				}
 				case FT_VAR_STRING:
@@ -1201,107 +1642,493 @@ MariaDBConnector::ErrorCode MariaDBConnector::_prepared_params_send(const uint32
 				case FT_DECIMAL:
 				case FT_JSON:
 				case FT_ENUM:
-				case FT_SET: {
-					PackedByteArray str_buf = value.operator String().to_utf8_buffer();
-					uint64_t len = str_buf.size();
-					if (len < 251) {
-						tx_buf.push_back(uint8_t(len));
-					} else {
-						tx_buf.push_back(0xFC);
-						tx_buf.push_back(len & 0xFF);
-						tx_buf.push_back((len >> 8) & 0xFF);
-					}
-					tx_buf.append_array(str_buf);
+				case FT_SET:
+				case FT_TINYBLOB:
+				case FT_MEDIUMBLOB:
+				case FT_LONGBLOB:
+				case FT_BLOB: {
+					PackedByteArray str_buf = value.get_type() == Variant::PACKED_BYTE_ARRAY
+												  ? PackedByteArray(value)
+												  : value.operator String().to_utf8_buffer();
+					_encode_lenenc(val_buf, str_buf.size());
+					val_buf.append_array(str_buf);
 					break;
 				}
 				default:
 					return ErrorCode::ERR_PREPARE_FAILED;
 			}
 		}
+		tx_buf.append_array(val_buf);
 	}
 
 	_add_packet_header(tx_buf, 0);
-	return (ErrorCode)_stream->put_data(tx_buf);
+	return ErrorCode::OK;
 }
 
-Variant MariaDBConnector::_query(const String& p_sql_stmt, const bool p_is_command) {
-	_last_error = ErrorCode::OK;
-	if (!is_connected_db()) {
-		_last_error = ErrorCode::ERR_NOT_CONNECTED;
-		if (p_is_command) {
-			return 0;
-		} else {
-			return ERR_NOT_CONNECTED;
-		}
-	}
-	if (!_authenticated) {
-		_last_error = ErrorCode::ERR_NOT_CONNECTED;
-		if (p_is_command) {
-			return 0;
-		} else {
-			return (uint32_t)ErrorCode::ERR_AUTH_FAILED;
-		}
+bool MariaDBConnector::_infer_field_type(const Variant& p_value, bool p_unsigned, FieldType& r_field_type) {
+	switch (p_value.get_type()) {
+		case Variant::BOOL:
+			r_field_type = FT_TINYINT;
+			return true;
+		case Variant::INT:
+			// A negative value sent as unsigned would wrap to 2^64 - n, signed it gets the server range check
+			r_field_type = p_unsigned && int64_t(p_value) >= 0 ? FT_BIGINT_U : FT_BIGINT;
+			return true;
+		case Variant::FLOAT:
+			r_field_type = FT_DOUBLE;
+			return true;
+		case Variant::STRING:
+		case Variant::STRING_NAME:
+			r_field_type = FT_VAR_STRING;
+			return true;
+		case Variant::PACKED_BYTE_ARRAY:
+			r_field_type = FT_BLOB;
+			return true;
+		default:
+			return false;
 	}
+}
 
-	PackedByteArray tx_bfr;
+void MariaDBConnector::_encode_lenenc(PackedByteArray& p_buf, uint64_t p_value) {
+	if (p_value < 251) {
+		p_buf.push_back(uint8_t(p_value));
+	} else if (p_value < 0x10000) {
+		p_buf.push_back(0xFC);
+		for (int b = 0; b < 2; ++b) p_buf.push_back((p_value >> (b * 8)) & 0xFF);
+	} else if (p_value < 0x1000000) {
+		p_buf.push_back(0xFD);
+		for (int b = 0; b < 3; ++b) p_buf.push_back((p_value >> (b * 8)) & 0xFF);
+	} else {
+		p_buf.push_back(0xFE);
+		for (int b = 0; b < 8; ++b) p_buf.push_back((p_value >> (b * 8)) & 0xFF);
+	}
+}
 
-	tx_bfr.push_back(0x03);	 // COM_QUERY
-	_last_query_converted = p_sql_stmt.to_utf8_buffer();
+MariaDBConnector::ErrorCode MariaDBConnector::_prepared_params_send(const uint32_t p_stmt_id, const Array& p_params) {
+	PackedByteArray tx_buf;
+	ErrorCode err = _prepared_params_pkt(p_stmt_id, p_params, tx_buf);
+	if (err != ErrorCode::OK) return err;
+	_last_transmitted = tx_buf;
+	return (ErrorCode)_stream->put_data(tx_buf);
+}
 
-	tx_bfr.append_array(_last_query_converted);
-	_add_packet_header(tx_bfr, 0);
+MariaDBConnector::ErrorCode MariaDBConnector::_prepare_response(PackedByteArray& p_rx_bfr,
+																size_t& p_pkt_idx,
+																Dictionary& r_info) {
+	// REF https://mariadb.com/kb/en/com_stmt_prepare/#com_stmt_prepare-response
+	const bool dep_eof = (_client_capabilities & (uint64_t)Capabilities::CLIENT_DEPRECATE_EOF);
+	int bfr_size = 0;
 
-	_last_transmitted = tx_bfr;
-	_stream_mutex->lock();
-	_last_error = (ErrorCode)_stream->put_data(tx_bfr);
+	_last_error = _rcv_bfr_chk(p_rx_bfr, bfr_size, p_pkt_idx, 4);
 	if (_last_error != OK) return _last_error;
+	size_t pkt_len = bytes_to_num_adv_itr<size_t>(p_rx_bfr.ptr(), 3, p_pkt_idx);
+	p_pkt_idx++;  // seq
+	_last_error = _rcv_bfr_chk(p_rx_bfr, bfr_size, p_pkt_idx, pkt_len);
+	if (_last_error != OK) {
+		ERR_PRINT(vformat("ERR_PACKET_LENGTH_MISMATCH rcvd %d expect %d", bfr_size, p_pkt_idx + pkt_len));
+		return _last_error;
+	}
 
-	Variant res = _com_query_response(p_is_command);
-	_stream_mutex->unlock();
-	return res;
-}
+	const size_t pkt_end = p_pkt_idx + pkt_len;
+	uint8_t status = p_rx_bfr[p_pkt_idx++];
+	if (status != 0) {
+		_handle_server_error(p_rx_bfr, p_pkt_idx);
+		p_pkt_idx = pkt_end;
+		_last_error = ErrorCode::ERR_PREPARE_FAILED;
+		return _last_error;
+	}
 
-MariaDBConnector::ErrorCode MariaDBConnector::_rcv_bfr_chk(PackedByteArray& p_bfr,
-														   int& p_bfr_size,
-														   const size_t p_cur_pos,
-														   const size_t p_bytes_needed) {
-	p_bfr_size = p_bfr.size();
-	if (p_bfr_size - p_cur_pos < p_bytes_needed) p_bfr.append_array(_read_buffer(_server_timout_msec));
+	uint32_t statement_id = bytes_to_num_adv_itr<uint32_t>(p_rx_bfr.ptr(), 4, p_pkt_idx);
+	uint16_t num_columns = bytes_to_num_adv_itr<uint16_t>(p_rx_bfr.ptr(), 2, p_pkt_idx);
+	uint16_t num_params = bytes_to_num_adv_itr<uint16_t>(p_rx_bfr.ptr(), 2, p_pkt_idx);
+	// string<1> reserved, int<2> warnings
+	p_pkt_idx = pkt_end;
 
-	p_bfr_size = p_bfr.size();
-	if (p_bfr_size - p_cur_pos < p_bytes_needed) {
-		return MariaDBConnector::ErrorCode::ERR_PACKET_LENGTH_MISMATCH;
-	} else {
-		return MariaDBConnector::ErrorCode::OK;
-	}
-}
+	r_info["statement_id"] = statement_id;
+	r_info["num_columns"] = num_columns;
+	r_info["num_params"] = num_params;
 
-PackedByteArray MariaDBConnector::_read_buffer(uint32_t p_timeout, uint32_t p_expected_bytes) {
-	int32_t byte_cnt = 0;
-	PackedByteArray out_buffer;
-	uint64_t start_msec = Time::get_singleton()->get_ticks_msec();
-	uint64_t time_lapse = 0;
-	bool data_rcvd = false;
-	while (is_connected_db() && time_lapse < p_timeout) {
-		_last_error = (ErrorCode)_stream->poll();
-		if (_last_error != OK) return PackedByteArray();
+	// Parameter definitions share the column definition layout
+	TypedArray<Dictionary> param_data = _read_columns_data(p_rx_bfr, p_pkt_idx, num_params);
+	if (_last_error != OK) return _last_error;
+	if (num_params > 0 && !dep_eof) {
+		_last_error = _skip_packet(p_rx_bfr, p_pkt_idx);
+		if (_last_error != OK) return _last_error;
+	}
 
-		byte_cnt = _stream->get_available_bytes();
-		if (byte_cnt > 0) {
-			out_buffer.append_array(_stream->get_data(byte_cnt)[1]);
-			data_rcvd = (p_expected_bytes == 0 || out_buffer.size() >= p_expected_bytes);
-		} else if (data_rcvd) {
-			break;
-		}
-		time_lapse = Time::get_singleton()->get_ticks_msec() - start_msec;
+	TypedArray<Dictionary> col_data = _read_columns_data(p_rx_bfr, p_pkt_idx, num_columns);
+	if (_last_error != OK) return _last_error;
+	if (num_columns > 0 && !dep_eof) {
+		_last_error = _skip_packet(p_rx_bfr, p_pkt_idx);
+		if (_last_error != OK) return _last_error;
 	}
 
-	return out_buffer;
+	_prep_column_data[statement_id] = col_data;
+	_prep_param_data[statement_id] = param_data;
+	return ErrorCode::OK;
 }
 
-TypedArray<Dictionary> MariaDBConnector::_read_columns_data(PackedByteArray& p_rx_bfr,
-															size_t& p_pkt_idx,
-															const uint16_t p_col_cnt) {
+Dictionary MariaDBConnector::_prepared_exec_response(PackedByteArray& p_rx_bfr,
+													 size_t& p_pkt_idx,
+													 uint32_t p_stmt_id) {
+	// REF https://mariadb.com/kb/en/com_stmt_execute/#response
+	// Returns the OK packet values, with "rows" when a result set was returned, empty on error.
+	const bool dep_eof = (_client_capabilities & (uint64_t)Capabilities::CLIENT_DEPRECATE_EOF);
+	int bfr_size = 0;
+
+	_last_error = _rcv_bfr_chk(p_rx_bfr, bfr_size, p_pkt_idx, 4);
+	if (_last_error != OK) {
+		_last_error = ErrorCode::ERR_NO_RESPONSE;
+		return Dictionary();
+	}
+	size_t pkt_len = bytes_to_num_adv_itr<size_t>(p_rx_bfr.ptr(), 3, p_pkt_idx);
+	p_pkt_idx++;  // seq
+	_last_error = _rcv_bfr_chk(p_rx_bfr, bfr_size, p_pkt_idx, pkt_len);
+	if (_last_error != OK) {
+		ERR_PRINT(vformat("ERR_PACKET_LENGTH_MISMATCH rcvd %d expect %d", bfr_size, p_pkt_idx + pkt_len));
+		return Dictionary();
+	}
+
+	const size_t pkt_end = p_pkt_idx + pkt_len;
+	uint8_t header = p_rx_bfr[p_pkt_idx];
+	if (header == 0xFF) {
+		_handle_server_error(p_rx_bfr, ++p_pkt_idx);
+		p_pkt_idx = pkt_end;
+		_last_error = ErrorCode::ERR_EXECUTE_FAILED;
+		return Dictionary();
+	} else if (header == 0x00) {
+		return _parse_ok_packet(p_rx_bfr, ++p_pkt_idx, pkt_end);
+	}
+
+	// Result set, int<lenenc> column count
+	uint64_t col_cnt = _decode_lenenc_adv_itr(p_rx_bfr, p_pkt_idx);
+	bool metadata_follows = true;
+	if ((_client_capabilities & (uint64_t)Capabilities::MARIADB_CLIENT_CACHE_METADATA) && p_pkt_idx < pkt_end) {
+		// int<1> metadata follows, the server skips the column definitions it already sent at prepare
+		metadata_follows = p_rx_bfr[p_pkt_idx] != 0;
+	}
+	p_pkt_idx = pkt_end;
+
+	TypedArray<Dictionary> col_data;
+	if (metadata_follows) {
+		col_data = _read_columns_data(p_rx_bfr, p_pkt_idx, col_cnt);
+		if (_last_error != OK) return Dictionary();
+		if (!dep_eof) {
+			_last_error = _skip_packet(p_rx_bfr, p_pkt_idx);
+			if (_last_error != OK) return Dictionary();
+		}
+		_prep_column_data[p_stmt_id] = col_data;
+	} else {
+		col_data = TypedArray<Dictionary>(_prep_column_data.get(p_stmt_id, TypedArray<Dictionary>()));
+	}
+
+	if ((uint64_t)col_data.size() != col_cnt) {
+		_last_error = ErrorCode::ERR_UNAVAILABLE;
+		ERR_PRINT(vformat("Prepared statement %d column metadata missing", p_stmt_id));
+		return Dictionary();
+	}
+
+	TypedArray<Dictionary> rows = _parse_prepared_exec(p_rx_bfr, p_pkt_idx, col_data, dep_eof);
+	if (_last_error != OK) return Dictionary();
+
+	Dictionary result = _parse_result_end(p_rx_bfr, p_pkt_idx, dep_eof);
+	if (_last_error != OK) return Dictionary();
+	if (!result.has("affected_rows")) result["affected_rows"] = rows.size();
+	result["rows"] = rows;
+	return result;
+}
+
+MariaDBConnector::ErrorCode MariaDBConnector::_skip_packet(PackedByteArray& p_rx_bfr, size_t& p_pkt_idx) {
+	int bfr_size = 0;
+	_last_error = _rcv_bfr_chk(p_rx_bfr, bfr_size, p_pkt_idx, 4);
+	if (_last_error != OK) {
+		ERR_PRINT(vformat("ERR_PACKET_LENGTH_MISMATCH rcvd %d expect %d", bfr_size, p_pkt_idx + 4));
+		return _last_error;
+	}
+	size_t pkt_len = bytes_to_num_adv_itr<size_t>(p_rx_bfr.ptr(), 3, p_pkt_idx);
+	p_pkt_idx++;  // seq
+	_last_error = _rcv_bfr_chk(p_rx_bfr, bfr_size, p_pkt_idx, pkt_len);
+	if (_last_error != OK) {
+		ERR_PRINT(vformat("ERR_PACKET_LENGTH_MISMATCH rcvd %d expect %d", bfr_size, p_pkt_idx + pkt_len));
+		return _last_error;
+	}
+	p_pkt_idx += pkt_len;
+	return ErrorCode::OK;
+}
+
+Variant MariaDBConnector::_query(const String& p_sql_stmt, const bool p_is_command, const uint32_t p_deadline_msec) {
+	PackedByteArray tx_bfr;
+	tx_bfr.resize(4);  // packet header, set once the size is known
+	tx_bfr.push_back(0x03);	 // COM_QUERY
+	_last_query_converted = p_sql_stmt.to_utf8_buffer();
+	// MariaDB aborts the statement itself at the deadline, MySQL has no per statement limit for every type
+	if (p_deadline_msec > 0 && !(_server_capabilities & (uint64_t)Capabilities::CLIENT_MYSQL)) {
+		const String prefix = vformat("SET STATEMENT max_statement_time=%.3f FOR ", p_deadline_msec / 1000.0);
+		tx_bfr.append_array(prefix.to_utf8_buffer());
+	}
+	tx_bfr.append_array(_last_query_converted);
+
+	return _query_tx(tx_bfr, p_is_command, p_deadline_msec);
+}
+
+Variant MariaDBConnector::_query_template(const Ref<MariaDBQueryTemplate>& p_template,
+										  const Array& p_params,
+										  const bool p_is_command) {
+	if (p_template.is_null()) {
+		_last_error = ErrorCode::ERR_INVALID_PARAMETER;
+		ERR_PRINT("Query template is null.");
+		return p_is_command ? Variant(0) : Variant(_last_error);
+	}
+
+	PackedByteArray tx_bfr;
+	tx_bfr.resize(4);  // packet header, set once the size is known
+	tx_bfr.push_back(0x03);	 // COM_QUERY
+	const bool no_backslash_escapes = _server_status & (uint16_t)ServerStatus::NO_BACKSLASH_ESCAPES;
+	if (p_template->append_sql(p_params, no_backslash_escapes, tx_bfr) != godot::OK) {
+		_last_error = ErrorCode::ERR_INVALID_PARAMETER;
+		return p_is_command ? Variant(0) : Variant(_last_error);
+	}
+	_last_query_converted = tx_bfr.slice(5);
+
+	return _query_tx(tx_bfr, p_is_command);
+}
+
+Variant MariaDBConnector::_query_tx(PackedByteArray& p_tx_bfr,
+									const bool p_is_command,
+									const uint32_t p_deadline_msec) {
+	_last_error = ErrorCode::OK;
+	_reconnect_if_lost();
+	if (!is_connected_db()) {
+		_last_error = ErrorCode::ERR_NOT_CONNECTED;
+		if (p_is_command) {
+			return 0;
+		} else {
+			return ERR_NOT_CONNECTED;
+		}
+	}
+	if (!_authenticated) {
+		_last_error = ErrorCode::ERR_NOT_CONNECTED;
+		if (p_is_command) {
+			return 0;
+		} else {
+			return (uint32_t)ErrorCode::ERR_AUTH_FAILED;
+		}
+	}
+
+	_set_packet_header(p_tx_bfr, 0);
+
+	_last_transmitted = p_tx_bfr;
+	_stream_mutex->lock();
+	_last_error = (ErrorCode)_stream->put_data(p_tx_bfr);
+	if (_last_error != OK) {
+		_stream_mutex->unlock();
+		return _last_error;
+	}
+
+	bool killed = false;
+	if (p_deadline_msec > 0 && !_await_response(p_deadline_msec, killed)) {
+		// Lost, or not even the kill was answered, a late reply would be read as the next statement's
+		_stream->disconnect_from_host();
+		_authenticated = false;
+		_stream_mutex->unlock();
+		_last_error = killed ? ErrorCode::ERR_DEADLINE_EXCEEDED : ErrorCode::ERR_NOT_CONNECTED;
+		return p_is_command ? Variant(0) : Variant((uint32_t)_last_error);
+	}
+
+	_last_server_error = 0;
+	Variant res = _com_query_response(p_is_command);
+	_stream_mutex->unlock();
+
+	// The reply of a statement stopped at the deadline is an ERR packet, the connection is in sync again
+	const bool timed_out = _last_server_error == kErStatementTimeout ||
+						   (killed && _last_server_error == kErQueryInterrupted);
+	if (p_deadline_msec > 0 && _last_error == ErrorCode::ERR_PACKET && timed_out) {
+		_last_error = ErrorCode::ERR_DEADLINE_EXCEEDED;
+		if (!p_is_command) res = (uint32_t)_last_error;
+	}
+	return res;
+}
+
+bool MariaDBConnector::_await_response(const uint32_t p_deadline_msec, bool& r_killed) {
+	// The server side max_statement_time normally answers first, the kill covers MySQL and statements it
+	// does not interrupt, like a wait on a lock or a stalled server
+	const uint64_t deadline_msec = Time::get_singleton()->get_ticks_msec() + p_deadline_msec;
+	uint64_t give_up_msec = deadline_msec + kDeadlineGraceMsec;
+	r_killed = false;
+	while (is_connected_db()) {
+		if (_stream->get_available_bytes() > 0) return true;
+
+		const uint64_t now_msec = Time::get_singleton()->get_ticks_msec();
+		if (now_msec >= give_up_msec) {
+			if (r_killed) return false;
+			r_killed = true;
+			// The kill and the ERR packet of the interrupted statement, read as usual to drain it, share one budget
+			give_up_msec = deadline_msec + kDeadlineKillMsec;
+			if (_kill_query(give_up_msec) != ErrorCode::OK) return false;
+		}
+		OS::get_singleton()->delay_usec(500);
+	}
+	return false;
+}
+
+MariaDBConnector::ErrorCode MariaDBConnector::_kill_query(const uint64_t p_give_up_msec) {
+	const auto remaining_msec = [p_give_up_msec]() -> uint32_t {
+		const uint64_t now_msec = Time::get_singleton()->get_ticks_msec();
+		return now_msec < p_give_up_msec ? (uint32_t)(p_give_up_msec - now_msec) : 0;
+	};
+
+	// A second session to the server this one is connected to, with the same credentials
+	Ref<MariaDBConnector> side;
+	side.instantiate();
+	side->_endpoint_hosts = PackedStringArray({ _ip });
+	side->_endpoint_ports = PackedInt32Array({ _port });
+	side->_ip_type = _ip_type;
+	// Every step waits no longer than what is left of the budget
+	side->_connect_timeout_msec = MAX(remaining_msec(), 1u);
+	side->_server_timout_msec = side->_connect_timeout_msec;
+	side->_client_auth_type = _client_auth_type;
+	side->_username = _username;
+	side->_password_hashed = _password_hashed;
+	side->_password_plain = _password_plain;
+	side->_ed25519_cred = _ed25519_cred;
+	side->_dbname = _dbname;
+
+	ErrorCode err = side->_connect();
+	if (err == ErrorCode::OK && side->_authenticated) {
+		side->_server_timout_msec = remaining_msec();
+		if (side->_server_timout_msec == 0) {
+			err = ErrorCode::ERR_DEADLINE_EXCEEDED;
+		} else {
+			side->_query(vformat("KILL QUERY %d", _connection_id), true);
+			err = side->_last_error;
+		}
+	} else if (err == ErrorCode::OK) {
+		err = ErrorCode::ERR_AUTH_FAILED;
+	}
+	side->disconnect_db();
+	if (err != ErrorCode::OK) ERR_PRINT(vformat("KILL QUERY %d failed with error %d.", _connection_id, (int)err));
+	return err;
+}
+
+MariaDBConnector::ErrorCode MariaDBConnector::_reconnect() {
+	const uint64_t now_msec = Time::get_singleton()->get_ticks_msec();
+	if (now_msec < _reconnect_next_msec) return ErrorCode::ERR_NOT_CONNECTED;
+
+	if (!_take_reconnect_token()) {
+		// Over the process wide rate, try again after a jittered base delay without counting a failure
+		_reconnect_next_msec = now_msec + (uint64_t)UtilityFunctions::randi_range(1, _reconnect_base_msec);
+		return ErrorCode::ERR_NOT_CONNECTED;
+	}
+
+	// The endpoints are resolved again so a DNS failover is followed, the handshake replays the init statements
+	ErrorCode err = _connect();
+	if (err == ErrorCode::OK && _authenticated) err = _reprepare_statements();
+
+	if (err != ErrorCode::OK || !_authenticated) {
+		// Full jitter, a random delay up to the exponential ceiling spreads the clients of a restarted server
+		if (_reconnect_failures < 16) _reconnect_failures++;
+		const uint64_t ceiling = MIN((uint64_t)_reconnect_base_msec << _reconnect_failures, _reconnect_max_msec);
+		_reconnect_next_msec = now_msec + (uint64_t)UtilityFunctions::randi_range(1, ceiling);
+		_reconnect_armed = true;
+		return err == ErrorCode::OK ? ErrorCode::ERR_NOT_CONNECTED : err;
+	}
+
+	_reconnect_failures = 0;
+	_reconnect_next_msec = 0;
+	_reconnect_count++;
+	return ErrorCode::OK;
+}
+
+void MariaDBConnector::_reconnect_if_lost() {
+	if (!_auto_reconnect || !_reconnect_armed) return;
+	if (_authenticated && is_connected_db()) return;
+	_last_error = _reconnect();
+}
+
+MariaDBConnector::ErrorCode MariaDBConnector::_reprepare_statements() {
+	// Handles stay as the caller got them, only the server ids behind them change
+	_prep_column_data.clear();
+	_prep_param_data.clear();
+	_stmt_remap.clear();
+
+	Array handles = _prep_sql.keys();
+	for (int i = 0; i < handles.size(); i++) {
+		const uint32_t handle = handles[i];
+		Dictionary info;
+		if (_prepare_stmt(_prep_sql[handle], info) != ErrorCode::OK) {
+			if (!is_connected_db()) return _last_error;
+			// The statement no longer prepares, e.g. a dropped table, its handle now fails like a closed one
+			ERR_PRINT(vformat("Statement %d could not be prepared again after reconnecting.", handle));
+			_prep_sql.erase(handle);
+			continue;
+		}
+		const uint32_t stmt_id = info["statement_id"];
+		if (stmt_id != handle) _stmt_remap[handle] = stmt_id;
+	}
+	return ErrorCode::OK;
+}
+
+void MariaDBConnector::_clear_statements() {
+	_prep_column_data.clear();
+	_prep_param_data.clear();
+	_prep_sql.clear();
+	_stmt_remap.clear();
+}
+
+uint32_t MariaDBConnector::_stmt_handle(const uint32_t p_server_stmt_id) {
+	// A statement prepared after a reconnect may get the server id an older handle was created with
+	if (!_prep_sql.has(p_server_stmt_id)) return p_server_stmt_id;
+	while (_prep_sql.has(_next_stmt_handle) || _next_stmt_handle == 0xFFFFFFFF) _next_stmt_handle++;
+	const uint32_t handle = _next_stmt_handle++;
+	_stmt_remap[handle] = p_server_stmt_id;
+	return handle;
+}
+
+uint32_t MariaDBConnector::_stmt_server_id(const uint32_t p_stmt_handle) const {
+	return _stmt_remap.has(p_stmt_handle) ? (uint32_t)_stmt_remap[p_stmt_handle] : p_stmt_handle;
+}
+
+MariaDBConnector::ErrorCode MariaDBConnector::_rcv_bfr_chk(PackedByteArray& p_bfr,
+														   int& p_bfr_size,
+														   const size_t p_cur_pos,
+														   const size_t p_bytes_needed) {
+	p_bfr_size = p_bfr.size();
+	if (p_bfr_size - p_cur_pos < p_bytes_needed) p_bfr.append_array(_read_buffer(_server_timout_msec));
+
+	p_bfr_size = p_bfr.size();
+	if (p_bfr_size - p_cur_pos < p_bytes_needed) {
+		return MariaDBConnector::ErrorCode::ERR_PACKET_LENGTH_MISMATCH;
+	} else {
+		return MariaDBConnector::ErrorCode::OK;
+	}
+}
+
+PackedByteArray MariaDBConnector::_read_buffer(uint32_t p_timeout, uint32_t p_expected_bytes) {
+	int32_t byte_cnt = 0;
+	PackedByteArray out_buffer;
+	uint64_t start_msec = Time::get_singleton()->get_ticks_msec();
+	uint64_t time_lapse = 0;
+	bool data_rcvd = false;
+	while (is_connected_db() && time_lapse < p_timeout) {
+		_last_error = (ErrorCode)_stream->poll();
+		if (_last_error != OK) return PackedByteArray();
+
+		byte_cnt = _stream->get_available_bytes();
+		if (byte_cnt > 0) {
+			out_buffer.append_array(_stream->get_data(byte_cnt)[1]);
+			data_rcvd = (p_expected_bytes == 0 || out_buffer.size() >= p_expected_bytes);
+		} else if (data_rcvd) {
+			break;
+		}
+		time_lapse = Time::get_singleton()->get_ticks_msec() - start_msec;
+	}
+
+	return out_buffer;
+}
+
+TypedArray<Dictionary> MariaDBConnector::_read_columns_data(PackedByteArray& p_rx_bfr,
+															size_t& p_pkt_idx,
+															const uint16_t p_col_cnt) {
 	int bfr_size = 0;
 	uint64_t len_encode = 0;
 	TypedArray<Dictionary> col_data;
@@ -1417,8 +2244,8 @@ MariaDBConnector::ErrorCode MariaDBConnector::_server_init_handshake_v10(const P
 	}
 
 	pkt_idx += str_len + 1;
-	// 4bytes - doesn't appear to be needed.
-	pkt_idx += 4;
+	// 4bytes - connection id
+	_connection_id = bytes_to_num_adv_itr<uint32_t>(buf_ptr, 4, pkt_idx);
 
 	// salt part 1 - 8 bytes
 	PackedByteArray server_salt = _get_pkt_bytes_adv_idx(p_src_buffer, pkt_idx, 8);
@@ -1434,10 +2261,8 @@ MariaDBConnector::ErrorCode MariaDBConnector::_server_init_handshake_v10(const P
 	pkt_idx++;
 
 	// 2bytes - Status flags
-	// uint16_t status = 0;
-	// status = (uint16_t)p_src_buffer[pkt_idx++;
-	// status += ((uint16_t)p_src_buffer[pkt_idx++]) << 8;
-	pkt_idx += 2;
+	_server_status = (uint16_t)p_src_buffer[pkt_idx++];
+	_server_status |= ((uint16_t)p_src_buffer[pkt_idx++]) << 8;
 
 	// 2bytes - server capabilities part 2
 	_server_capabilities += ((uint64_t)p_src_buffer[pkt_idx++]) << 16;
@@ -1483,6 +2308,8 @@ MariaDBConnector::ErrorCode MariaDBConnector::_server_init_handshake_v10(const P
 	// determine which auth method the server can use
 	AuthType p_srvr_auth_type = _get_server_auth_type(tmp);
 
+	// Kept for COM_CHANGE_USER, the server reuses the handshake scramble
+	_srvr_salt = server_salt;
 	return _client_protocol_v41(p_srvr_auth_type, server_salt);
 }  // server_init_handshake_v10
 
@@ -1491,51 +2318,101 @@ void MariaDBConnector::_hash_password(String p_password) {
 	if (_client_auth_type == AUTH_TYPE_MYSQL_NATIVE) {
 		_password_hashed = p_password.sha1_buffer();
 	} else if (_client_auth_type == AUTH_TYPE_ED25519) {
-		_password_hashed.resize(64);
-
-		mbedtls_sha512_context ctx;
-		mbedtls_sha512_init(&ctx);
-		mbedtls_sha512_starts(&ctx, 0);
-		mbedtls_sha512_update(&ctx, reinterpret_cast<const uint8_t*>(p_password.utf8().ptr()), p_password.length());
-		mbedtls_sha512_finish(&ctx, _password_hashed.ptrw());
-		mbedtls_sha512_free(&ctx);
+		_password_hashed = Ed25519Credential::hash_password(p_password);
+	} else if (_client_auth_type == AUTH_TYPE_CACHING_SHA2) {
+		_password_hashed = p_password.sha256_buffer();
 	}
 }
 
-void MariaDBConnector::_update_username(String p_username) { _username = p_username.to_utf8_buffer(); }
+MariaDBConnector::ErrorCode MariaDBConnector::_init_stmts_response(PackedByteArray& p_rx_bfr, size_t& p_pkt_idx) {
+	// Consumes every result of the session init multi-statement, they end at the first OK or EOF packet
+	// without SERVER_MORE_RESULTS_EXIST, or at an ERR packet which aborts the remaining statements.
+	const bool dep_eof = (_client_capabilities & (uint64_t)Capabilities::CLIENT_DEPRECATE_EOF);
+	bool in_result_set = false;
+	int eofs_left = 0;
+	int bfr_size = 0;
 
-// public
-MariaDBConnector::ErrorCode MariaDBConnector::connect_db(const String& p_host,
-														 const int p_port,
-														 const String& p_dbname,
-														 const String& p_username,
-														 const String& p_password,
-														 const AuthType p_authtype,
-														 const bool p_is_prehashed) {
-	if (p_host.is_valid_ip_address()) {
-		_ip = p_host;
-	} else {
-		_ip = IP::get_singleton()->resolve_hostname(p_host, (IP::Type)_ip_type);
-	}
+	while (true) {
+		_last_error = _rcv_bfr_chk(p_rx_bfr, bfr_size, p_pkt_idx, 4);
+		if (_last_error != OK) {
+			ERR_PRINT(vformat("ERR_PACKET_LENGTH_MISMATCH rcvd %d expect %d", bfr_size, p_pkt_idx + 4));
+			return _last_error;
+		}
 
-	if (!_ip.is_valid_ip_address()) {
-		ERR_PRINT("Invalid hostname or IP address");
-		return ErrorCode::ERR_INVALID_HOSTNAME;
-	}
+		size_t pkt_len = bytes_to_num_adv_itr<size_t>(p_rx_bfr.ptr(), 3, p_pkt_idx);
+		p_pkt_idx++;  // seq
+		_last_error = _rcv_bfr_chk(p_rx_bfr, bfr_size, p_pkt_idx, pkt_len);
+		if (_last_error != OK) {
+			ERR_PRINT(vformat("ERR_PACKET_LENGTH_MISMATCH rcvd %d expect %d", bfr_size, p_pkt_idx + pkt_len));
+			return _last_error;
+		}
 
-	if (p_port <= 0 || p_port > 65535) {
-		ERR_PRINT("Invalid port");
-		return ErrorCode::ERR_INVALID_PORT;
-	}
-	_port = p_port;
+		const size_t pkt_end = p_pkt_idx + pkt_len;
+		size_t itr = p_pkt_idx;
+		uint8_t header = p_rx_bfr[itr++];
+		uint16_t status_flags = 0;
+
+		if (header == 0xFF) {
+			_handle_server_error(p_rx_bfr, itr);
+			p_pkt_idx = pkt_end;
+			_last_error = ErrorCode::ERR_INIT_ERROR;
+			return _last_error;
+		} else if (!in_result_set && header == 0x00) {
+			// OK packet, int<lenenc> affected rows, int<lenenc> last insert id, int<2> status
+			_decode_lenenc_adv_itr(p_rx_bfr, itr);
+			_decode_lenenc_adv_itr(p_rx_bfr, itr);
+			status_flags = bytes_to_num_adv_itr<uint16_t>(p_rx_bfr.ptr(), 2, itr);
+		} else if (!in_result_set) {
+			// Column count packet, an init statement returned rows, they are skipped
+			in_result_set = true;
+			eofs_left = dep_eof ? 1 : 2;
+			p_pkt_idx = pkt_end;
+			continue;
+		} else if (header == 0xFE && pkt_len < 0xFFFFFF && --eofs_left == 0) {
+			if (dep_eof) {
+				// OK packet with EOF header
+				_decode_lenenc_adv_itr(p_rx_bfr, itr);
+				_decode_lenenc_adv_itr(p_rx_bfr, itr);
+			} else {
+				// EOF packet, int<2> warnings first
+				itr += 2;
+			}
+			status_flags = bytes_to_num_adv_itr<uint16_t>(p_rx_bfr.ptr(), 2, itr);
+			in_result_set = false;
+		} else {
+			// Column definition, row or intermediate EOF packet
+			p_pkt_idx = pkt_end;
+			continue;
+		}
 
-	if (p_dbname.length() <= 0 && _client_capabilities & (uint64_t)Capabilities::CONNECT_WITH_DB) {
-		ERR_PRINT("dbname not set");
-		return ErrorCode::ERR_DB_NAME_EMPTY;
-	} else {
-		set_db_name(p_dbname);
+		p_pkt_idx = pkt_end;
+		// The last status carries the transaction and NO_BACKSLASH_ESCAPES state the init statements left
+		_server_status = status_flags;
+		if (!(status_flags & (uint16_t)ServerStatus::MORE_RESULTS_EXIST)) break;
 	}
 
+	_last_error = ErrorCode::OK;
+	return _last_error;
+}
+
+MariaDBConnector::ErrorCode MariaDBConnector::_init_stmts_send() {
+	// Used when the session init statements could not be pipelined behind another packet
+	if (_init_stmt_pkt.is_empty()) return ErrorCode::OK;
+
+	_auth_round_trips++;
+	_last_error = (ErrorCode)_stream->put_data(_init_stmt_pkt);
+	if (_last_error != OK) return _last_error;
+
+	PackedByteArray rx_bfr = _read_buffer(_server_timout_msec);
+	size_t pkt_idx = 0;
+	return _init_stmts_response(rx_bfr, pkt_idx);
+}
+
+MariaDBConnector::ErrorCode MariaDBConnector::_set_credentials(const String& p_username,
+																const String& p_password,
+																const AuthType p_authtype,
+																const bool p_is_prehashed,
+																const Ed25519CredentialPtr& p_ed25519_cred) {
 	if (p_username.length() <= 0) {
 		ERR_PRINT("username not set");
 		return ErrorCode::ERR_USERNAME_EMPTY;
@@ -1559,17 +2436,102 @@ MariaDBConnector::ErrorCode MariaDBConnector::connect_db(const String& p_host,
 				ERR_PRINT("Password not proper for ED25519, must be 128 hex characters!");
 				return ErrorCode::ERR_PASSWORD_HASH_LENGTH;
 			}
+		} else if (p_authtype == AUTH_TYPE_CACHING_SHA2) {
+			if (!is_valid_hex(p_password, 64)) {
+				ERR_PRINT("Password not proper for caching_sha2_password, must be 64 hex characters!");
+				return ErrorCode::ERR_PASSWORD_HASH_LENGTH;
+			}
 		}
+	}
 
+	// The hash type depends on the auth type, so it must be set before hashing
+	_client_auth_type = p_authtype;
+	_password_plain.fill(0);
+	_password_plain.clear();
+	_password_hashed.fill(0);
+	_ed25519_cred.reset();
+	if (p_authtype == AUTH_TYPE_ED25519 && p_ed25519_cred) {
+		// Already derived by the context, no hashing or public key derivation per connection
+		_ed25519_cred = p_ed25519_cred;
+		_password_hashed.clear();
+	} else if (p_is_prehashed) {
 		_password_hashed = p_password.hex_decode();
-
 	} else {
 		_hash_password(p_password);
+		// caching_sha2_password full authentication sends the password itself when the server cache is cold
+		if (p_authtype == AUTH_TYPE_CACHING_SHA2) _password_plain = p_password.to_utf8_buffer();
+	}
+
+	if (p_authtype == AUTH_TYPE_ED25519 && !_ed25519_cred) {
+		// The public key is derived once here instead of on every signature, only the key material is kept
+		_ed25519_cred = Ed25519Credential::create(_password_hashed);
+		_password_hashed.fill(0);
+		_password_hashed.clear();
 	}
 
 	_update_username(p_username);
+	return ErrorCode::OK;
+}
 
-	_client_auth_type = p_authtype;
+void MariaDBConnector::_update_username(String p_username) { _username = p_username.to_utf8_buffer(); }
+
+// public
+MariaDBConnector::ErrorCode MariaDBConnector::connect_db(const String& p_host,
+														 const int p_port,
+														 const String& p_dbname,
+														 const String& p_username,
+														 const String& p_password,
+														 const AuthType p_authtype,
+														 const bool p_is_prehashed) {
+	return _connect_db(PackedStringArray({ p_host }),
+					   PackedInt32Array({ p_port }),
+					   p_dbname,
+					   p_username,
+					   p_password,
+					   p_authtype,
+					   p_is_prehashed,
+					   nullptr);
+}
+
+MariaDBConnector::ErrorCode MariaDBConnector::_connect_db(const PackedStringArray& p_hosts,
+														  const PackedInt32Array& p_ports,
+														  const String& p_dbname,
+														  const String& p_username,
+														  const String& p_password,
+														  const AuthType p_authtype,
+														  const bool p_is_prehashed,
+														  const Ed25519CredentialPtr& p_ed25519_cred) {
+	// Resolved on each connect through the DNS cache, only a hostname never seen before waits on the resolver
+	if (p_hosts.is_empty() || p_hosts.size() != p_ports.size()) {
+		ERR_PRINT("Invalid hostname or IP address");
+		return ErrorCode::ERR_INVALID_HOSTNAME;
+	}
+
+	for (int i = 0; i < p_ports.size(); i++) {
+		if (p_ports[i] <= 0 || p_ports[i] > 65535) {
+			ERR_PRINT("Invalid port");
+			return ErrorCode::ERR_INVALID_PORT;
+		}
+	}
+	_endpoint_hosts = p_hosts;
+	_endpoint_ports = p_ports;
+	for (const String& host : _endpoint_hosts) MariaDBDnsCache::prefetch(host, (IP::Type)_ip_type);
+
+	if (p_dbname.length() <= 0 && _client_capabilities & (uint64_t)Capabilities::CONNECT_WITH_DB) {
+		ERR_PRINT("dbname not set");
+		return ErrorCode::ERR_DB_NAME_EMPTY;
+	} else {
+		// Applied by the handshake, not a live switch on a connection about to be replaced
+		_dbname = p_dbname.to_utf8_buffer();
+	}
+
+	ErrorCode err = _set_credentials(p_username, p_password, p_authtype, p_is_prehashed, p_ed25519_cred);
+	if (err != ErrorCode::OK) return err;
+
+	// A new session, the statements of the previous one are not carried over
+	_clear_statements();
+	_reconnect_failures = 0;
+	_reconnect_next_msec = 0;
 	return _connect();
 }
 
@@ -1579,56 +2541,34 @@ MariaDBConnector::ErrorCode MariaDBConnector::connect_db_ctx(const Ref<MariaDBCo
 		return ErrorCode::ERR_INIT_ERROR;
 	}
 
-	const int encoding = p_context->get_encoding();
-	String password = p_context->get_password();
-	const bool is_prehashed = p_context->get_is_prehashed();
-
-	if (encoding == MariaDBConnectContext::ENCODE_BASE64) {
-		// BASE64 should always be treated as binary -> hex
-		password = Marshalls::get_singleton()->base64_to_raw(password).hex_encode();
-	} else if (is_prehashed) {
-		if (encoding == MariaDBConnectContext::ENCODE_PLAIN) {
-			// convert plain to hex
-			password = password.to_utf8_buffer().hex_encode();
-		}
-		// Just pass hex
-	}
-	// hex decode is dangerous, just pass the unmodified string if hex or plain
+	return _connect_ctx(p_context);
+}
 
-	return connect_db(p_context->get_hostname(),
-					  p_context->get_port(),
-					  p_context->get_db_name(),
-					  p_context->get_username(),
-					  password,
-					  static_cast<MariaDBConnector::AuthType>(p_context->get_auth_type()),
-					  is_prehashed);
+MariaDBConnector::ErrorCode MariaDBConnector::_connect_ctx(const Ref<MariaDBConnectContext>& p_context) {
+	set_init_statements(p_context->get_init_statements());
+	_connect_strategy = p_context->get_connect_strategy();
+	set_connect_timeout(MAX(p_context->get_connect_timeout_msec(), 1));
+	_race_delay_msec = MAX(p_context->get_race_delay_msec(), 0);
+
+	PackedStringArray hosts;
+	PackedInt32Array ports;
+	p_context->get_endpoints(hosts, ports);
+	return _connect_db(hosts,
+					   ports,
+					   p_context->get_db_name(),
+					   p_context->get_username(),
+					   p_context->get_connect_password(),
+					   static_cast<MariaDBConnector::AuthType>(p_context->get_auth_type()),
+					   p_context->get_is_prehashed(),
+					   p_context->get_ed25519_credential());
 }
 
 Ref<MariaDBConnector> MariaDBConnector::connection_instance(const Ref<MariaDBConnectContext>& p_context) {
 	ERR_FAIL_COND_V_EDMSG(p_context.is_null(), Ref<MariaDBConnector>(), "ConnectionContext is null.");
 
-	const int encoding = p_context->get_encoding();
-	String password = p_context->get_password();
-	const bool is_prehashed = p_context->get_is_prehashed();
-
-	if (encoding == MariaDBConnectContext::ENCODE_BASE64) {
-		PackedByteArray raw = Marshalls::get_singleton()->base64_to_raw(password);
-		password = raw.hex_encode();
-	} else if (is_prehashed && encoding == MariaDBConnectContext::ENCODE_PLAIN) {
-		PackedByteArray raw = password.to_utf8_buffer();
-		password = raw.hex_encode();
-	}
-
 	Ref<MariaDBConnector> conn;
 	conn.instantiate();
-
-	ErrorCode err = conn->connect_db(p_context->get_hostname(),
-									 p_context->get_port(),
-									 p_context->get_db_name(),
-									 p_context->get_username(),
-									 password,
-									 static_cast<AuthType>(p_context->get_auth_type()),
-									 is_prehashed);
+	ErrorCode err = conn->_connect_ctx(p_context);
 
 	ERR_FAIL_COND_V_EDMSG(
 			err != ErrorCode::OK, Ref<MariaDBConnector>(), vformat("Failed to connect: error code %d", int(err)));
@@ -1648,10 +2588,96 @@ void MariaDBConnector::disconnect_db() {
 		_stream->disconnect_from_host();
 	}
 	_authenticated = false;
+	_reconnect_armed = false;
 	_stream_mutex->unlock();
 }
 
-Dictionary MariaDBConnector::excecute_command(const String& p_sql_stmt) { return _query(p_sql_stmt, true); }
+MariaDBConnector::ErrorCode MariaDBConnector::change_user(const String& p_username,
+														  const String& p_password,
+														  const String& p_dbname,
+														  const AuthType p_authtype,
+														  const bool p_is_prehashed) {
+	if (!is_connected_db()) {
+		_last_error = ErrorCode::ERR_NOT_CONNECTED;
+		return _last_error;
+	}
+
+	// The auth exchange signs with the new credentials, the old ones come back if the server rejects them
+	const AuthType prev_authtype = _client_auth_type;
+	const AuthType prev_auth_plugin = _auth_plugin;
+	const PackedByteArray prev_username = _username;
+	PackedByteArray prev_password_hashed = _password_hashed;
+	PackedByteArray prev_password_plain = _password_plain;
+	const Ed25519CredentialPtr prev_ed25519_cred = _ed25519_cred;
+
+	_last_error = _set_credentials(p_username, p_password, p_authtype, p_is_prehashed);
+	if (_last_error != ErrorCode::OK) return _last_error;
+	const PackedByteArray username = p_username.to_utf8_buffer();
+	const PackedByteArray dbname = p_dbname.to_utf8_buffer();
+
+	// Per https://mariadb.com/kb/en/com_change_user/
+	PackedByteArray tx_bfr;
+	tx_bfr.push_back(0x11);	 // COM_CHANGE_USER
+
+	// string<NUL> username
+	tx_bfr.append_array(username);
+	tx_bfr.push_back(0);
+
+	// The server reuses the scramble sent in the initial handshake
+	const AuthType auth_plugin = p_authtype;
+	PackedByteArray auth_response_pba;
+	if (auth_plugin != AUTH_TYPE_ED25519) {
+		auth_response_pba = _auth_plugin_data(auth_plugin, _srvr_salt.slice(0, 20));
+	}
+	_append_auth_data(tx_bfr, auth_response_pba);
+
+	// string<NUL> default database name
+	tx_bfr.append_array(dbname);
+	tx_bfr.push_back(0);
+
+	// int<2> character set
+	tx_bfr.push_back(kCharacterCollationId);
+	tx_bfr.push_back(0);
+
+	// string<NUL> authentication plugin name
+	tx_bfr.append_array(kAuthTypeNames[(size_t)auth_plugin].to_ascii_buffer());
+	tx_bfr.push_back(0);
+
+	_add_packet_header(tx_bfr, 0);
+	_last_transmitted = tx_bfr;
+
+	_stream_mutex->lock();
+	// Nothing runs as the old user once the request is out, only an OK authenticates the new one
+	_authenticated = false;
+	_auth_plugin = auth_plugin;
+	_auth_round_trips = 1;
+	_last_error = (ErrorCode)_stream->put_data(tx_bfr);
+	if (_last_error == OK) _last_error = _auth_response(_read_buffer(_server_timout_msec));
+	if (_authenticated) {
+		_dbname = dbname;
+		_current_db = p_dbname;
+		prev_password_hashed.fill(0);
+		prev_password_plain.fill(0);
+	} else {
+		_client_auth_type = prev_authtype;
+		_auth_plugin = prev_auth_plugin;
+		_username = prev_username;
+		_password_hashed.fill(0);
+		_password_hashed = prev_password_hashed;
+		_password_plain.fill(0);
+		_password_plain = prev_password_plain;
+		_ed25519_cred = prev_ed25519_cred;
+	}
+	// The server frees every prepared statement of the previous session
+	_clear_statements();
+	_stream_mutex->unlock();
+
+	return _last_error;
+}
+
+Dictionary MariaDBConnector::excecute_command(const String& p_sql_stmt, const uint32_t p_deadline_msec) {
+	return _query(p_sql_stmt, true, p_deadline_msec);
+}
 
 PackedByteArray MariaDBConnector::get_last_query_converted() { return _last_query_converted; }
 
@@ -1662,10 +2688,29 @@ PackedByteArray MariaDBConnector::get_last_transmitted() { return _last_transmit
 PackedByteArray MariaDBConnector::get_client_ed25519_signature(const PackedByteArray& p_sha512_hashed_passwd,
 															   const PackedByteArray& p_svr_msg) {
 	// MySQL does not supprt this auth method
-	PackedByteArray rtn_val;
-	rtn_val.resize(64);
-	ed25519_sign_msg(p_sha512_hashed_passwd.ptr(), p_svr_msg.ptr(), 32, rtn_val.ptrw());
-	return rtn_val;
+	ERR_FAIL_COND_V_EDMSG(
+			p_sha512_hashed_passwd.size() != 64, PackedByteArray(), "The password hash must be 64 bytes of SHA-512.");
+	ERR_FAIL_COND_V_EDMSG(p_svr_msg.size() < 32, PackedByteArray(), "The server message must be 32 bytes.");
+	return Ed25519Credential(p_sha512_hashed_passwd.ptr()).sign(p_svr_msg.slice(0, 32));
+}
+
+String MariaDBConnector::get_ed25519_backend() { return Ed25519Credential::backend(); }
+
+PackedByteArray MariaDBConnector::get_caching_sha2_passwd_hash(const PackedByteArray& p_sha256_hashed_passwd,
+															   const PackedByteArray& p_srvr_salt) {
+	// Per https://dev.mysql.com/doc/dev/mysql-server/latest/page_caching_sha2_authentication_exchanges.html
+	// XOR(SHA256(password), SHA256(SHA256(SHA256(password)), scramble))
+	PackedByteArray combined = _sha256(p_sha256_hashed_passwd);
+	combined.append_array(p_srvr_salt.slice(0, 20));
+	PackedByteArray digest = _sha256(combined);
+
+	PackedByteArray hash_out;
+	hash_out.resize(32);
+	for (int i = 0; i < 32; i++) {
+		hash_out.set(i, p_sha256_hashed_passwd[i] ^ digest[i]);
+	}
+
+	return hash_out;
 }
 
 PackedByteArray MariaDBConnector::get_mysql_native_password_hash(const PackedByteArray& p_sha1_hashed_passwd,
@@ -1697,157 +2742,245 @@ PackedByteArray MariaDBConnector::get_mysql_native_password_hash(const PackedByt
 	return hash_out;
 }
 
+Dictionary MariaDBConnector::get_connect_stats() const {
+	Dictionary stats;
+	stats["round_trips"] = _auth_round_trips;
+	stats["usec"] = _connect_usec;
+	stats["auth_plugin"] = kAuthTypeNames[(size_t)_auth_plugin];
+	stats["reconnects"] = _reconnect_count;
+	return stats;
+}
+
 bool MariaDBConnector::is_connected_db() {
 	_last_error = (ErrorCode)_stream->poll();
 	return _stream->get_status() == StreamPeerTCP::STATUS_CONNECTED;
 }
 
-void MariaDBConnector::ping_srvr() {
+bool MariaDBConnector::is_in_transaction() const {
+	if (!_authenticated) return false;
+	const bool in_trans = _server_status & (uint16_t)ServerStatus::IN_TRANS;
+	return in_trans || !(_server_status & (uint16_t)ServerStatus::AUTOCOMMIT);
+}
+
+MariaDBConnector::ErrorCode MariaDBConnector::ping_srvr() {
+	// No reconnect, a lost connection is what the caller wants to learn about
+	if (!is_connected_db() || !_authenticated) {
+		_last_error = ErrorCode::ERR_NOT_CONNECTED;
+		return _last_error;
+	}
+
+	// Per https://mariadb.com/kb/en/com_ping/
 	_stream_mutex->lock();
-	if (is_connected_db()) _stream->put_data(PackedByteArray({ 0x01, 0x00, 0x00, 0x00, 0x0E }));
-	PackedByteArray ret = _read_buffer(1000, 12);
+	_last_error = (ErrorCode)_stream->put_data(PackedByteArray({ 0x01, 0x00, 0x00, 0x00, 0x0E }));
+	if (_last_error != OK) {
+		_stream_mutex->unlock();
+		return _last_error;
+	}
+
+	// The header and the 7 byte OK packet, returns as soon as they arrived
+	PackedByteArray rx_bfr = _read_buffer(_server_timout_msec, 11);
+	if (rx_bfr.size() <= 4) {
+		_stream_mutex->unlock();
+		_last_error = ErrorCode::ERR_NO_RESPONSE;
+		return _last_error;
+	}
+
+	size_t pkt_idx = 0;
+	size_t pkt_len = bytes_to_num_adv_itr<size_t>(rx_bfr.ptr(), 3, pkt_idx);
+	pkt_idx++;
+	uint8_t header = rx_bfr[pkt_idx++];
+	if (header == 0x00) {
+		_parse_ok_packet(rx_bfr, pkt_idx, 4 + pkt_len);
+	} else if (header == 0xFF) {
+		_handle_server_error(rx_bfr, pkt_idx);
+		_last_error = ErrorCode::ERR_PACKET;
+	} else {
+		_last_error = ErrorCode::ERR_UNKNOWN;
+		ERR_PRINT("Unexpected header byte: " + itos(header));
+	}
 	_stream_mutex->unlock();
+	return _last_error;
 }
 
-Dictionary MariaDBConnector::prepared_statement(const String& p_sql) {
+Dictionary MariaDBConnector::prepare_and_execute(const String& p_sql, const Array& p_params, const bool p_close) {
+	// The statement id of a pipelined execute or close is unknown when sent, MariaDB accepts
+	// 0xFFFFFFFF for the statement last prepared on the connection.
+	const uint32_t kLastStmtId = 0xFFFFFFFF;
 	_last_error = ErrorCode::OK;
+	Dictionary result;
 
-	PackedByteArray send_buffer_vec;
-	send_buffer_vec.push_back(0x16);  // COM_STMT_PREPARE code (0x16)
-	send_buffer_vec.append_array(p_sql.to_utf8_buffer());
-	_add_packet_header(send_buffer_vec, 0);
-	_last_transmitted = send_buffer_vec;
+	_reconnect_if_lost();
+	if (!is_connected_db() || !_authenticated) {
+		_last_error = ErrorCode::ERR_NOT_CONNECTED;
+		return result;
+	}
+
+	PackedByteArray tx_bfr;
+	tx_bfr.push_back(0x16);	 // COM_STMT_PREPARE
+	tx_bfr.append_array(p_sql.to_utf8_buffer());
+	_add_packet_header(tx_bfr, 0);
+
+	// MySQL has no "last statement" id, the packets have to wait for the prepare response there
+	const bool pipelined = !(_server_capabilities & (uint64_t)Capabilities::CLIENT_MYSQL);
+	PackedByteArray exec_bfr;
+	if (pipelined) {
+		_last_error = _prepared_params_pkt(kLastStmtId, p_params, exec_bfr);
+		if (_last_error != OK) return result;
+		tx_bfr.append_array(exec_bfr);
+		if (p_close) {
+			// COM_STMT_CLOSE has no response
+			PackedByteArray close_bfr;
+			close_bfr.resize(5);
+			close_bfr[0] = 0x19;  // COM_STMT_CLOSE
+			close_bfr.encode_u32(1, kLastStmtId);
+			_add_packet_header(close_bfr, 0);
+			tx_bfr.append_array(close_bfr);
+		}
+	}
+	_last_transmitted = tx_bfr;
 
 	_stream_mutex->lock();
-	_last_error = (ErrorCode)_stream->put_data(send_buffer_vec);
-	if (_last_error != OK) return Dictionary();
+	_last_error = (ErrorCode)_stream->put_data(tx_bfr);
+	if (_last_error != OK) {
+		_stream_mutex->unlock();
+		return result;
+	}
+
 	PackedByteArray rx_bfr = _read_buffer(_server_timout_msec);
 	if (rx_bfr.is_empty()) {
 		_last_error = ErrorCode::ERR_NO_RESPONSE;
 		_stream_mutex->unlock();
-		return Dictionary();
+		return result;
 	}
 
 	size_t pkt_idx = 0;
-	size_t pkt_len = bytes_to_num_adv_itr<size_t>(rx_bfr.ptr(), 3, pkt_idx);
-	int bfr_size = 0;
-	_last_error = _rcv_bfr_chk(rx_bfr, bfr_size, pkt_idx, pkt_len);
-	if (_last_error != OK) {
-		ERR_PRINT(vformat("ERR_PACKET_LENGTH_MISMATCH rcvd %d expect %d", bfr_size, pkt_idx + pkt_len));
+	Dictionary info;
+	if (_prepare_response(rx_bfr, pkt_idx, info) != OK) {
+		ErrorCode err = _last_error;
+		if (pipelined && err == ErrorCode::ERR_PREPARE_FAILED) {
+			// The pipelined execute is answered with an unknown statement error, drain it
+			_skip_packet(rx_bfr, pkt_idx);
+		}
+		_last_error = err;
 		_stream_mutex->unlock();
-		return Dictionary();
+		return result;
 	}
-	uint8_t seq_num = rx_bfr[pkt_idx++];
-	uint8_t status = rx_bfr[pkt_idx++];
 
-	if (status != 0) {
-		_last_error = ErrorCode::ERR_PREPARE_FAILED;
-		_handle_server_error(rx_bfr, pkt_idx);
-		_stream_mutex->unlock();
-		return Dictionary();
+	uint32_t stmt_id = info["statement_id"];
+	if (!pipelined) {
+		_last_error = _prepared_params_send(stmt_id, p_params);
+		if (_last_error != OK) {
+			_stream_mutex->unlock();
+			return result;
+		}
+		rx_bfr = _read_buffer(_server_timout_msec);
+		pkt_idx = 0;
 	}
 
-	uint32_t statement_id = bytes_to_num_adv_itr<uint32_t>(rx_bfr.ptr(), 4, pkt_idx);
-	uint16_t num_columns = bytes_to_num_adv_itr<uint16_t>(rx_bfr.ptr(), 2, pkt_idx);
-	uint16_t num_params = bytes_to_num_adv_itr<uint16_t>(rx_bfr.ptr(), 2, pkt_idx);
+	Dictionary exec_res = _prepared_exec_response(rx_bfr, pkt_idx, stmt_id);
+	if (!pipelined && p_close) {
+		PackedByteArray close_bfr;
+		close_bfr.resize(5);
+		close_bfr[0] = 0x19;  // COM_STMT_CLOSE
+		close_bfr.encode_u32(1, stmt_id);
+		_add_packet_header(close_bfr, 0);
+		_stream->put_data(close_bfr);
+	}
+	_stream_mutex->unlock();
 
-	pkt_idx += 3;
+	if (p_close) {
+		_prep_column_data.erase(stmt_id);
+		_prep_param_data.erase(stmt_id);
+	} else {
+		const uint32_t handle = _stmt_handle(stmt_id);
+		_prep_sql[handle] = p_sql;
+		result["statement_id"] = handle;
+	}
 
-	Dictionary info;
-	info["statement_id"] = statement_id;
-	info["num_columns"] = num_columns;
-	info["num_params"] = num_params;
+	// A kept statement is registered either way, the caller still gets its handle to retry or close it
+	if (_last_error != OK) return result;
+	result.merge(exec_res);
+	return result;
+}
 
-	TypedArray<Dictionary> col_data;
-	for (size_t p = 0; p < num_params; ++p) {
-		// process parameter def packet
-		pkt_len = bytes_to_num_adv_itr<size_t>(rx_bfr.ptr(), 3, pkt_idx);
-		_last_error = _rcv_bfr_chk(rx_bfr, bfr_size, pkt_idx, pkt_len);
-		if (_last_error != OK) {
-			ERR_PRINT(vformat("ERR_PACKET_LENGTH_MISMATCH rcvd %d expect %d", bfr_size, pkt_idx + pkt_len));
-			return Dictionary();
-		}
-		seq_num = rx_bfr[pkt_idx++];
-		pkt_idx += pkt_len;
-	}
+Dictionary MariaDBConnector::prepared_statement(const String& p_sql) {
+	_last_error = ErrorCode::OK;
+	_reconnect_if_lost();
 
-	col_data = _read_columns_data(rx_bfr, pkt_idx, num_columns);
-	_stream_mutex->unlock();
-	_prep_column_data[statement_id] = col_data;
+	Dictionary info;
+	if (_prepare_stmt(p_sql, info) != OK) return Dictionary();
 
+	// Kept so the statement can be prepared again on a new connection under the same handle
+	const uint32_t handle = _stmt_handle(info["statement_id"]);
+	_prep_sql[handle] = p_sql;
+	info["statement_id"] = handle;
 	return info;
 }
 
-TypedArray<Dictionary> MariaDBConnector::prepared_stmt_exec_select(uint32_t p_stmt_id,
-																   const TypedArray<Dictionary>& p_params) {
-	// TypedArray<Dictionary> MariaDBConnector::exec_prepped_select(uint32_t p_stmt_id, const Array &p_params) {
-	// _last_error = _prepared_select_params_send(p_stmt_id, p_params);
+MariaDBConnector::ErrorCode MariaDBConnector::_prepare_stmt(const String& p_sql, Dictionary& r_info) {
+	PackedByteArray send_buffer_vec;
+	send_buffer_vec.push_back(0x16);  // COM_STMT_PREPARE code (0x16)
+	send_buffer_vec.append_array(p_sql.to_utf8_buffer());
+	_add_packet_header(send_buffer_vec, 0);
+	_last_transmitted = send_buffer_vec;
+
 	_stream_mutex->lock();
-	_last_error = _prepared_params_send(p_stmt_id, p_params);
+	_last_error = (ErrorCode)_stream->put_data(send_buffer_vec);
 	if (_last_error != OK) {
-		return TypedArray<Dictionary>();
+		_stream_mutex->unlock();
+		return _last_error;
 	}
-
 	PackedByteArray rx_bfr = _read_buffer(_server_timout_msec);
 	if (rx_bfr.is_empty()) {
 		_last_error = ErrorCode::ERR_NO_RESPONSE;
 		_stream_mutex->unlock();
-		return TypedArray<Dictionary>();
+		return _last_error;
 	}
 
 	size_t pkt_idx = 0;
-	size_t pkt_len = bytes_to_num_adv_itr<size_t>(rx_bfr.ptr(), 3, pkt_idx);
-	int bfr_size = 0;
-	_last_error = _rcv_bfr_chk(rx_bfr, bfr_size, pkt_idx, pkt_len);
-	if (_last_error != OK) {
-		_stream_mutex->unlock();
-		ERR_PRINT(vformat("ERR_PACKET_LENGTH_MISMATCH rcvd %d expect %d", bfr_size, pkt_idx + pkt_len));
-		return TypedArray<Dictionary>();
-	}
-	size_t seq_num = rx_bfr[pkt_idx++];
+	_prepare_response(rx_bfr, pkt_idx, r_info);
+	_stream_mutex->unlock();
+	return _last_error;
+}
 
-	uint8_t status = rx_bfr[pkt_idx];
-	if (status == 0xFF) {
-		_handle_server_error(rx_bfr, ++pkt_idx);
-		_last_error = ERR_PREPARE_FAILED;
+TypedArray<Dictionary> MariaDBConnector::prepared_stmt_exec_select(uint32_t p_stmt_id, const Array& p_params) {
+	_reconnect_if_lost();
+	const uint32_t stmt_id = _stmt_server_id(p_stmt_id);
+	_stream_mutex->lock();
+	_last_error = _prepared_params_send(stmt_id, p_params);
+	if (_last_error != OK) {
 		_stream_mutex->unlock();
 		return TypedArray<Dictionary>();
 	}
 
-	pkt_idx += 2;  // Skip over column count and status byte
-
-	TypedArray<Dictionary> col_data = _prep_column_data.get(p_stmt_id, TypedArray<Dictionary>());
-	if (col_data.size() == 0) {
-		uint8_t marker = rx_bfr[pkt_idx++];
-		if (marker == 0xFF) {
-			// Proper error marker
-			_last_error = ERR_UNAVAILABLE;
-			ERR_PRINT("exec_prepped_select failed: ERR packet received");
-		} else {
-			_last_error = ERR_UNAVAILABLE;
-			ERR_PRINT(vformat("exec_prepped_select unexpected marker: 0x%02X", marker));
-		}
+	PackedByteArray rx_bfr = _read_buffer(_server_timout_msec);
+	if (rx_bfr.is_empty()) {
+		_last_error = ErrorCode::ERR_NO_RESPONSE;
 		_stream_mutex->unlock();
 		return TypedArray<Dictionary>();
 	}
 
-	bool dep_eof = (_client_capabilities & (uint64_t)Capabilities::CLIENT_DEPRECATE_EOF);
+	size_t pkt_idx = 0;
+	Dictionary res = _prepared_exec_response(rx_bfr, pkt_idx, stmt_id);
+	_stream_mutex->unlock();
 
-	Variant rows = _parse_prepared_exec(rx_bfr, pkt_idx, col_data, dep_eof);
-	if (rows.get_type() != Variant::ARRAY) {
+	if (_last_error != OK) return TypedArray<Dictionary>();
+	if (!res.has("rows")) {
+		// OK packet, not a SELECT
 		_last_error = ERR_UNAVAILABLE;
-		_stream_mutex->unlock();
+		ERR_PRINT("exec_prepped_select failed: no result set received");
 		return TypedArray<Dictionary>();
 	}
 
-	_stream_mutex->unlock();
-	return TypedArray<Dictionary>(rows);
+	return TypedArray<Dictionary>(res["rows"]);
 }
 
-Dictionary MariaDBConnector::prepared_stmt_exec_cmd(uint32_t p_stmt_id, const TypedArray<Dictionary>& p_params) {
+Dictionary MariaDBConnector::prepared_stmt_exec_cmd(uint32_t p_stmt_id, const Array& p_params) {
+	_reconnect_if_lost();
+	const uint32_t stmt_id = _stmt_server_id(p_stmt_id);
 	_stream_mutex->lock();
 
-	_last_error = _prepared_params_send(p_stmt_id, p_params);
+	_last_error = _prepared_params_send(stmt_id, p_params);
 	if (_last_error != OK) {
 		_stream_mutex->unlock();
 		return Dictionary();
@@ -1860,54 +2993,15 @@ Dictionary MariaDBConnector::prepared_stmt_exec_cmd(uint32_t p_stmt_id, const Ty
 	}
 
 	size_t pkt_idx = 0;
-	size_t pkt_len = bytes_to_num_adv_itr<size_t>(rx_bfr.ptr(), 3, pkt_idx);
-	int bfr_size = 0;
-	_last_error = _rcv_bfr_chk(rx_bfr, bfr_size, pkt_idx, pkt_len);
-	if (_last_error != OK) {
-		_stream_mutex->unlock();
-		ERR_PRINT(vformat("ERR_PACKET_LENGTH_MISMATCH rcvd %d expect %d", bfr_size, pkt_idx + pkt_len));
-		return Dictionary();
-	}
-
-	pkt_idx++;
-
-	uint8_t header = rx_bfr.decode_u8(pkt_idx++);
-	if (header == 0xFF) {
-		// ERR Packet
-		_handle_server_error(rx_bfr, pkt_idx);
-		_last_error = ErrorCode::ERR_EXECUTE_FAILED;
-		_stream_mutex->unlock();
-		return Dictionary();
-	} else if (header == 0x00) {
-		// OK Packet
-		uint64_t affected_rows = _decode_lenenc_adv_itr(rx_bfr, pkt_idx);
-		uint64_t last_insert_id = _decode_lenenc_adv_itr(rx_bfr, pkt_idx);
-		uint16_t status_flags = bytes_to_num_adv_itr<uint16_t>(rx_bfr.ptr(), 2, pkt_idx);
-		uint16_t warnings = bytes_to_num_adv_itr<uint16_t>(rx_bfr.ptr(), 2, pkt_idx);
-
-		String info;
-		if (pkt_idx < rx_bfr.size()) {
-			info = String::utf8((const char*)&rx_bfr[pkt_idx], rx_bfr.size() - pkt_idx);
-		}
+	Dictionary res = _prepared_exec_response(rx_bfr, pkt_idx, stmt_id);
+	_stream_mutex->unlock();
 
-		Dictionary result;
-		result["affected_rows"] = affected_rows;
-		result["last_insert_id"] = last_insert_id;
-		result["status_flags"] = status_flags;
-		result["warnings"] = warnings;
-		result["info"] = info;
-		_stream_mutex->unlock();
-		return result;
-	} else {
-		// Possibly a result set packet — not handled in this path
-		_last_error = (ErrorCode)ERR_PARSE_ERROR;
-		_stream_mutex->unlock();
-		ERR_PRINT("Unexpected header byte: " + itos(header));
-		return Dictionary();
-	}
+	if (_last_error != OK) return Dictionary();
+	return res;
 }
 
-MariaDBConnector::ErrorCode MariaDBConnector::prepared_statement_close(uint32_t stmt_id) {
+MariaDBConnector::ErrorCode MariaDBConnector::prepared_statement_close(uint32_t p_stmt_id) {
+	const uint32_t stmt_id = _stmt_server_id(p_stmt_id);
 	PackedByteArray tx_bfr;
 	tx_bfr.resize(5);
 	tx_bfr[0] = 0x19;  // COM_STMT_CLOSE
@@ -1915,20 +3009,40 @@ MariaDBConnector::ErrorCode MariaDBConnector::prepared_statement_close(uint32_t
 	_add_packet_header(tx_bfr, 0);
 	_stream_mutex->lock();
 	_last_error = (ErrorCode)_stream->put_data(tx_bfr);
+	_prep_column_data.erase(stmt_id);
+	_prep_param_data.erase(stmt_id);
+	_prep_sql.erase(p_stmt_id);
+	_stmt_remap.erase(p_stmt_id);
 	_stream_mutex->unlock();
 	return _last_error;
 }
 
-TypedArray<Dictionary> MariaDBConnector::select_query(const String& p_sql_stmt) {
+TypedArray<Dictionary> MariaDBConnector::select_query(const String& p_sql_stmt, const uint32_t p_deadline_msec) {
+	return _select_rows(_query(p_sql_stmt, false, p_deadline_msec));
+}
+
+Variant MariaDBConnector::query_template(const Ref<MariaDBQueryTemplate>& p_template, const Array& p_params) {
+	return _query_template(p_template, p_params);
+}
+
+TypedArray<Dictionary> MariaDBConnector::select_template(const Ref<MariaDBQueryTemplate>& p_template,
+														 const Array& p_params) {
+	return _select_rows(_query_template(p_template, p_params));
+}
+
+Dictionary MariaDBConnector::execute_template(const Ref<MariaDBQueryTemplate>& p_template, const Array& p_params) {
+	return _query_template(p_template, p_params, true);
+}
+
+TypedArray<Dictionary> MariaDBConnector::_select_rows(const Variant& p_query_result) {
 	TypedArray<Dictionary> result;
-	Variant query_result = _query(p_sql_stmt);
 
-	if (query_result.get_type() == Variant::INT) {
+	if (p_query_result.get_type() == Variant::INT) {
 		// Not a valid SELECT response, INSERT, DELETE, UPDATE or error
 		return result;
 	}
 
-	Array raw_array = query_result;
+	Array raw_array = p_query_result;
 	for (int i = 0; i < raw_array.size(); i++) {
 		if (raw_array[i].get_type() == Variant::DICTIONARY) {
 			result.push_back(raw_array[i]);
@@ -1938,13 +3052,183 @@ TypedArray<Dictionary> MariaDBConnector::select_query(const String& p_sql_stmt)
 	return result;
 }
 
+MariaDBConnector::ErrorCode MariaDBConnector::reset_session() {
+	_reconnect_if_lost();
+	if (!is_connected_db() || !_authenticated) {
+		_last_error = ErrorCode::ERR_NOT_CONNECTED;
+		return _last_error;
+	}
+
+	// Per https://mariadb.com/kb/en/com_reset_connection/
+	PackedByteArray tx_bfr;
+	tx_bfr.push_back(0x1F);	 // COM_RESET_CONNECTION
+	_add_packet_header(tx_bfr, 0);
+	// The reset restores the session variables, replay the session init statements in the same flight
+	tx_bfr.append_array(_init_stmt_pkt);
+	_last_transmitted = tx_bfr;
+
+	_stream_mutex->lock();
+	_last_error = (ErrorCode)_stream->put_data(tx_bfr);
+	if (_last_error != OK) {
+		_stream_mutex->unlock();
+		return _last_error;
+	}
+
+	PackedByteArray rx_bfr = _read_buffer(_server_timout_msec);
+	// The server frees every prepared statement of the session
+	_clear_statements();
+
+	if (rx_bfr.size() <= 4) {
+		_stream_mutex->unlock();
+		_last_error = ErrorCode::ERR_NO_RESPONSE;
+		return _last_error;
+	}
+
+	size_t pkt_idx = 0;
+	size_t pkt_len = bytes_to_num_adv_itr<size_t>(rx_bfr.ptr(), 3, pkt_idx);
+	pkt_idx++;
+	uint8_t header = rx_bfr[pkt_idx++];
+	ErrorCode err = ErrorCode::OK;
+	if (header == 0xFF) {
+		_handle_server_error(rx_bfr, pkt_idx);
+		err = ErrorCode::ERR_PACKET;
+	} else if (header != 0x00) {
+		err = ErrorCode::ERR_UNKNOWN;
+		ERR_PRINT("Unexpected header byte: " + itos(header));
+	}
+
+	// The init statements are executed whatever the reset result, their responses must be drained
+	if (!_init_stmt_pkt.is_empty()) {
+		pkt_idx = 4 + pkt_len;
+		_init_stmts_response(rx_bfr, pkt_idx);
+		if (err == ErrorCode::OK) err = _last_error;
+	}
+	_stream_mutex->unlock();
+
+	_last_error = err;
+	return _last_error;
+}
+
 void MariaDBConnector::set_dbl_to_string(bool p_is_to_str) { _dbl_to_string = p_is_to_str; }
 
-// TODO If db is not the same and connected then change db on server
 void MariaDBConnector::set_db_name(String p_dbname) {
-	_dbname = p_dbname.to_utf8_buffer();
+	const PackedByteArray dbname = p_dbname.to_utf8_buffer();
 	// _dbname = p_dbname.to_ascii_buffer(); // TODO Add character set
 	// compatibility??
+
+	// Not connected, it is used on the next handshake, already current saves a round trip
+	if (p_dbname.is_empty() || p_dbname == _current_db || !_authenticated || !is_connected_db()) {
+		_dbname = dbname;
+		return;
+	}
+
+	// Per https://mariadb.com/kb/en/com_init_db/
+	// _dbname is only replaced once the server accepts the schema, reconnects and side connections send it
+	PackedByteArray tx_bfr;
+	tx_bfr.push_back(0x02);	 // COM_INIT_DB
+	tx_bfr.append_array(dbname);
+	_add_packet_header(tx_bfr, 0);
+	_last_transmitted = tx_bfr;
+
+	_stream_mutex->lock();
+	_last_error = (ErrorCode)_stream->put_data(tx_bfr);
+	if (_last_error != OK) {
+		_stream_mutex->unlock();
+		return;
+	}
+
+	PackedByteArray rx_bfr = _read_buffer(_server_timout_msec);
+	if (rx_bfr.size() <= 4) {
+		_last_error = ErrorCode::ERR_NO_RESPONSE;
+		_stream_mutex->unlock();
+		return;
+	}
+
+	size_t pkt_idx = 0;
+	size_t pkt_len = bytes_to_num_adv_itr<size_t>(rx_bfr.ptr(), 3, pkt_idx);
+	pkt_idx++;
+	uint8_t header = rx_bfr[pkt_idx++];
+	if (header == 0x00) {
+		String requested_db = p_dbname;
+		_dbname = dbname;
+		_current_db = requested_db;
+		// With session tracking the server confirms the new schema in the OK packet
+		_parse_ok_packet(rx_bfr, pkt_idx, 4 + pkt_len);
+		if (_current_db != requested_db) {
+			_last_error = ErrorCode::ERR_UNKNOWN;
+			ERR_PRINT("Server reported schema " + _current_db + " after switching to " + requested_db);
+		}
+	} else if (header == 0xFF) {
+		_handle_server_error(rx_bfr, pkt_idx);
+		_last_error = ErrorCode::ERR_PACKET;
+	} else {
+		_last_error = ErrorCode::ERR_UNKNOWN;
+		ERR_PRINT("Unexpected header byte: " + itos(header));
+	}
+	_stream_mutex->unlock();
+}
+
+void MariaDBConnector::set_init_statements(const PackedStringArray& p_statements) {
+	_init_statements = p_statements;
+	_init_stmt_pkt.clear();
+
+	String multi_stmt;
+	for (int i = 0; i < p_statements.size(); ++i) {
+		String stmt = p_statements[i].strip_edges().trim_suffix(";");
+		if (stmt.is_empty()) continue;
+		if (!multi_stmt.is_empty()) multi_stmt += ";";
+		multi_stmt += stmt;
+	}
+	if (_track_gtid) {
+		if (!multi_stmt.is_empty()) multi_stmt += ";";
+		multi_stmt += kTrackGtidStmt;
+	}
+	if (multi_stmt.is_empty()) return;
+
+	// Encoded once, it is sent as a single multi-statement COM_QUERY on every (re)authentication
+	_init_stmt_pkt.push_back(0x03);	 // COM_QUERY
+	_init_stmt_pkt.append_array(multi_stmt.to_utf8_buffer());
+	_add_packet_header(_init_stmt_pkt, 0);
+}
+
+void MariaDBConnector::set_track_gtid(bool p_enable) {
+	if (_track_gtid == p_enable) return;
+	_track_gtid = p_enable;
+	set_init_statements(_init_statements);
+
+	// Later sessions get it from the init statements, the current one is switched now
+	if (_track_gtid && _authenticated) {
+		_query(kTrackGtidStmt, true);
+		if (_last_error != OK) ERR_PRINT("Failed to enable last_gtid session tracking.");
+	}
 }
 
 void MariaDBConnector::set_ip_type(IpType p_type) { _ip_type = p_type; }
+
+void MariaDBConnector::set_connect_timeout(uint32_t p_msec) { _connect_timeout_msec = MAX(p_msec, 1u); }
+
+void MariaDBConnector::set_auto_reconnect(bool p_enable, uint32_t p_base_msec, uint32_t p_max_msec) {
+	_auto_reconnect = p_enable;
+	_reconnect_base_msec = MAX(p_base_msec, 1u);
+	_reconnect_max_msec = MAX(p_max_msec, _reconnect_base_msec);
+	_reconnect_failures = 0;
+	_reconnect_next_msec = 0;
+}
+
+void MariaDBConnector::set_dns_cache_ttl(uint32_t p_ttl_sec, uint32_t p_stale_sec) {
+	MariaDBDnsCache::set_ttl(p_ttl_sec * 1000, p_stale_sec * 1000);
+}
+
+void MariaDBConnector::prefetch_hostname(const String& p_hostname, IpType p_ip_type) {
+	MariaDBDnsCache::prefetch(p_hostname, (IP::Type)p_ip_type);
+}
+
+void MariaDBConnector::clear_dns_cache() { MariaDBDnsCache::clear(); }
+
+void MariaDBConnector::set_reconnect_rate_limit(double p_per_sec, int p_burst) {
+	std::lock_guard<std::mutex> lock(s_reconnect_rate_mutex);
+	s_reconnect_per_sec = p_per_sec;
+	s_reconnect_burst = MAX(p_burst, 1);
+	s_reconnect_tokens = s_reconnect_burst;
+	s_reconnect_refill_usec = 0;
+}
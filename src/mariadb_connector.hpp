@@ -33,6 +33,8 @@
 
 #include "mariadb_connect_context.hpp"
 #include "mariadb_connector_common.hpp"
+#include "mariadb_ed25519_credential.hpp"
+#include "mariadb_query_template.hpp"
 
 #include <godot_cpp/classes/ip.hpp>
 #include <godot_cpp/classes/ref_counted.hpp>
@@ -56,6 +58,7 @@ public:
 	enum AuthType {
 		AUTH_TYPE_ED25519 = MariaDBConnectorCommon::AUTH_TYPE_ED25519,
 		AUTH_TYPE_MYSQL_NATIVE = MariaDBConnectorCommon::AUTH_TYPE_MYSQL_NATIVE,
+		AUTH_TYPE_CACHING_SHA2 = MariaDBConnectorCommon::AUTH_TYPE_CACHING_SHA2,
 		AUTH_TYPE_LAST = MariaDBConnectorCommon::AUTH_TYPE_LAST
 	};
 
@@ -92,7 +95,8 @@ public:
 		ERR_PACKET,
 		ERR_INVALID_PARAMETER,
 		ERR_PREPARE_FAILED,
-		ERR_EXECUTE_FAILED
+		ERR_EXECUTE_FAILED,
+		ERR_DEADLINE_EXCEEDED
 	};
 
 	enum FieldType : uint8_t {
@@ -175,21 +179,80 @@ private:
 		MARIADB_CLIENT_CACHE_METADATA = (1ULL << 36)
 	};
 
-	const String kAuthTypeNamesStr = "client_ed25519,mysql_native_password";
+	//https://mariadb.com/kb/en/ok_packet/#server-status-flag
+	enum class ServerStatus : uint16_t {
+		IN_TRANS = (1U << 0),
+		AUTOCOMMIT = (1U << 1),
+		MORE_RESULTS_EXIST = (1U << 3),
+		QUERY_NO_GOOD_INDEX_USED = (1U << 4),
+		QUERY_NO_INDEX_USED = (1U << 5),
+		CURSOR_EXISTS = (1U << 6),
+		LAST_ROW_SENT = (1U << 7),
+		DB_DROPPED = (1U << 8),
+		NO_BACKSLASH_ESCAPES = (1U << 9),
+		METADATA_CHANGED = (1U << 10),
+		QUERY_WAS_SLOW = (1U << 11),
+		PS_OUT_PARAMS = (1U << 12),
+		IN_TRANS_READONLY = (1U << 13),
+		SESSION_STATE_CHANGED = (1U << 14)
+	};
+
+	const String kAuthTypeNamesStr = "client_ed25519,mysql_native_password,caching_sha2_password";
 	const PackedStringArray kAuthTypeNames = kAuthTypeNamesStr.split(",");
 	bool _dbl_to_string = false;
 	IpType _ip_type = IpType::IP_TYPE_ANY;
 	AuthType _client_auth_type = AUTH_TYPE_ED25519;
+	// Plugin of the current auth exchange, named in the handshake or set by an auth switch
+	AuthType _auth_plugin = AUTH_TYPE_MYSQL_NATIVE;
+	// Login exchanges after the TCP connect, each a client packet waiting on a server reply
+	uint32_t _auth_round_trips = 0;
+	uint64_t _connect_usec = 0;
 	bool _authenticated = false;
 	uint64_t _client_capabilities = 0;
 	uint64_t _server_capabilities = 0;
 
 	PackedByteArray _username;
 	PackedByteArray _password_hashed;
+	// client_ed25519 key material, replaces _password_hashed and may be shared through a MariaDBConnectContext
+	Ed25519CredentialPtr _ed25519_cred;
+	// Only kept for caching_sha2_password full authentication
+	PackedByteArray _password_plain;
+	PackedByteArray _srvr_public_key;
 	PackedByteArray _dbname;
+	String _current_db;
+	PackedByteArray _srvr_salt;
+	uint16_t _server_status = 0;
+	// Thread id of the session from the handshake, the target of KILL QUERY
+	uint32_t _connection_id = 0;
+	// Error number of the last ERR packet
+	uint16_t _last_server_error = 0;
+	PackedStringArray _init_statements;
+	PackedByteArray _init_stmt_pkt;
+	// GTID of the last write committed by this session, reported by session tracking when _track_gtid is set
+	bool _track_gtid = false;
+	String _last_gtid;
+
+	// Automatic reconnect, opt-in with set_auto_reconnect, armed by a login and disarmed by disconnect_db
+	bool _auto_reconnect = false;
+	bool _reconnect_armed = false;
+	uint32_t _reconnect_base_msec = 100;
+	uint32_t _reconnect_max_msec = 10000;
+	uint32_t _reconnect_failures = 0;
+	uint64_t _reconnect_next_msec = 0;
+	uint32_t _reconnect_count = 0;
+	// Statement handle -> SQL, re-prepared after a reconnect, and handle -> server statement id when they differ
+	Dictionary _prep_sql;
+	Dictionary _stmt_remap;
+	uint32_t _next_stmt_handle = 0x80000000;
 
 	Ref<StreamPeerTCP> _stream;
 	Mutex* _stream_mutex = nullptr;
+	// Candidate servers of the next (re)connect, see _open_stream
+	PackedStringArray _endpoint_hosts;
+	PackedInt32Array _endpoint_ports;
+	MariaDBConnectContext::ConnectStrategy _connect_strategy = MariaDBConnectContext::CONNECT_ORDERED;
+	uint32_t _connect_timeout_msec = 1000;
+	uint32_t _race_delay_msec = 50;
 	String _ip;
 	int _port = 0;
 	uint32_t _server_timout_msec = 1000;
@@ -216,17 +279,40 @@ private:
 	 * \param sequance	int
 	 */
 	void _add_packet_header(PackedByteArray& p_pkt, uint8_t p_pkt_seq);
+	void _set_packet_header(PackedByteArray& p_pkt, uint8_t p_pkt_seq);
+	ErrorCode _auth_response(const PackedByteArray& p_srvr_response);
 
 	// void m_append_thread_data(PackedByteArray &p_data, const uint64_t p_timeout = 1000);
 	// void m_tcp_thread_func();
 
 	ErrorCode _client_protocol_v41(const AuthType p_srvr_auth_type, const PackedByteArray p_srvr_salt);
 	ErrorCode _connect();
+	ErrorCode _open_stream();
+	ErrorCode _connect_ctx(const Ref<MariaDBConnectContext>& p_context);
+	ErrorCode _connect_db(const PackedStringArray& p_hosts,
+						  const PackedInt32Array& p_ports,
+						  const String& p_dbname,
+						  const String& p_username,
+						  const String& p_password,
+						  const AuthType p_authtype,
+						  const bool p_is_prehashed,
+						  const Ed25519CredentialPtr& p_ed25519_cred);
 	PackedByteArray _get_pkt_bytes_adv_idx(const PackedByteArray& src_buf, size_t& start_pos, const size_t byte_cnt);
 	AuthType _get_server_auth_type(String p_srvr_auth_name);
+	PackedByteArray _auth_plugin_data(const AuthType p_plugin, const PackedByteArray& p_nonce);
+	void _append_auth_data(PackedByteArray& p_buf, const PackedByteArray& p_auth_data);
+	PackedByteArray _caching_sha2_encrypt_password(const PackedByteArray& p_public_key_pem,
+												   const PackedByteArray& p_nonce);
 	Variant _get_type_data(const int p_db_field_type, const PackedByteArray& p_data, const int p_char_set);
-	void _handle_server_error(const PackedByteArray p_src_buffer, size_t& p_last_pos);
+	uint16_t _handle_server_error(const PackedByteArray p_src_buffer, size_t& p_last_pos);
 	void _hash_password(String p_password);
+	ErrorCode _init_stmts_response(PackedByteArray& rx_bfr, size_t& pkt_idx);
+	ErrorCode _init_stmts_send();
+	ErrorCode _set_credentials(const String& p_username,
+							   const String& p_password,
+							   const AuthType p_authtype,
+							   const bool p_is_prehashed,
+							   const Ed25519CredentialPtr& p_ed25519_cred = nullptr);
 	TypedArray<Dictionary> _parse_prepared_exec(PackedByteArray& buf,
 												size_t& pkt_itr,
 												const TypedArray<Dictionary>& col_defs,
@@ -237,8 +323,30 @@ private:
 											  const bool dep_eof);
 	String _parse_null_utf8_at_adv_idx(PackedByteArray p_buf, size_t& p_start_pos);
 	String _parse_null_utf8(PackedByteArray p_buf);
-	ErrorCode _prepared_params_send(const uint32_t stmt_id, const TypedArray<Dictionary>& params);
-	Variant _query(const String& sql_stmt, const bool is_command = false);
+	Dictionary _parse_ok_packet(const PackedByteArray& rx_bfr, size_t& pkt_idx, size_t pkt_end);
+	Dictionary _parse_result_end(PackedByteArray& rx_bfr, size_t& pkt_idx, const bool dep_eof);
+	ErrorCode _prepare_response(PackedByteArray& rx_bfr, size_t& pkt_idx, Dictionary& r_info);
+	ErrorCode _prepare_stmt(const String& sql, Dictionary& r_info);
+	Dictionary _prepared_exec_response(PackedByteArray& rx_bfr, size_t& pkt_idx, uint32_t stmt_id);
+	ErrorCode _prepared_params_pkt(const uint32_t stmt_id, const Array& params, PackedByteArray& r_tx_buf);
+	ErrorCode _prepared_params_send(const uint32_t stmt_id, const Array& params);
+	static bool _infer_field_type(const Variant& value, bool is_unsigned, FieldType& r_field_type);
+	static void _encode_lenenc(PackedByteArray& buf, uint64_t value);
+	Variant _query(const String& sql_stmt, const bool is_command = false, const uint32_t deadline_msec = 0);
+	Variant _query_template(const Ref<MariaDBQueryTemplate>& sql_template,
+							const Array& params,
+							const bool is_command = false);
+	Variant _query_tx(PackedByteArray& tx_bfr, const bool is_command, const uint32_t deadline_msec = 0);
+	bool _await_response(const uint32_t deadline_msec, bool& r_killed);
+	ErrorCode _kill_query(const uint64_t give_up_msec);
+	ErrorCode _reconnect();
+	void _reconnect_if_lost();
+	ErrorCode _reprepare_statements();
+	void _clear_statements();
+	uint32_t _stmt_handle(const uint32_t server_stmt_id);
+	uint32_t _stmt_server_id(const uint32_t stmt_handle) const;
+	TypedArray<Dictionary> _select_rows(const Variant& query_result);
+	ErrorCode _skip_packet(PackedByteArray& rx_bfr, size_t& pkt_idx);
 	ErrorCode _rcv_bfr_chk(PackedByteArray& bfr, int& bfr_size, const size_t cur_pos, const size_t bytes_needed);
 	PackedByteArray _read_buffer(uint32_t timeout, uint32_t expected_bytes = 0);
 	TypedArray<Dictionary> _read_columns_data(PackedByteArray& srvr_response, size_t& pkt_itr, const uint16_t col_cnt);
@@ -250,6 +358,7 @@ private:
 protected:
 	static void _bind_methods();
 	Dictionary _prep_column_data;
+	Dictionary _prep_param_data;
 	enum MySqlFieldType : uint8_t {
 		MYSQL_TYPE_DECIMAL = 0,
 		MYSQL_TYPE_TINY = 1,
@@ -280,6 +389,15 @@ protected:
 		MYSQL_TYPE_STRING = 254,
 		MYSQL_TYPE_GEOMETRY = 255
 	};
+	//https://mariadb.com/kb/en/ok_packet/#session-change-type
+	enum SessionTrackType : uint8_t {
+		SESSION_TRACK_SYSTEM_VARIABLES = 0,
+		SESSION_TRACK_SCHEMA = 1,
+		SESSION_TRACK_STATE_CHANGE = 2,
+		SESSION_TRACK_GTIDS = 3,
+		SESSION_TRACK_TRANSACTION_CHARACTERISTICS = 4,
+		SESSION_TRACK_TRANSACTION_STATE = 5
+	};
 	enum Sign : uint8_t {
 		SIGN_SIGNED = 0x00,
 		SIGN_UNSIGNED = 0x80
@@ -308,41 +426,142 @@ public:
 						 bool is_prehashed = true);
 
 	ErrorCode connect_db_ctx(const Ref<MariaDBConnectContext>& p_context);
+	/**
+	 * \brief				Re-authenticates the open connection as another user with COM_CHANGE_USER,
+	 *						the session is reset as if newly connected without a new TCP handshake.
+	 * \return 				ErrorCode, OK on success.
+	 */
+	ErrorCode change_user(const String& username,
+						  const String& password,
+						  const String& dbname,
+						  const AuthType auth_type = AuthType::AUTH_TYPE_ED25519,
+						  bool is_prehashed = true);
 	void disconnect_db();
-	Dictionary excecute_command(const String& sql_stmt);
+	Dictionary excecute_command(const String& sql_stmt, const uint32_t deadline_msec = 0);
 	static Ref<MariaDBConnector> connection_instance(const Ref<MariaDBConnectContext>& p_context);
 	ErrorCode get_last_error() const { return _last_error; }
 	PackedByteArray get_last_query_converted();
 	PackedByteArray get_last_response();
 	PackedByteArray get_last_transmitted();
 
-	// PackedByteArray get_caching_sha2_passwd_hash(PackedByteArray p_sha256_hashed_passwd, PackedByteArray
-	// p_srvr_salt);
+	PackedByteArray get_caching_sha2_passwd_hash(const PackedByteArray& p_sha256_hashed_passwd,
+												 const PackedByteArray& p_srvr_salt);
 	PackedByteArray get_client_ed25519_signature(const PackedByteArray& p_sha512_hashed_passwd,
 												 const PackedByteArray& p_svr_msg);
+	static String get_ed25519_backend();
 	PackedByteArray get_mysql_native_password_hash(const PackedByteArray& p_sha1_hashed_passwd,
 												   const PackedByteArray& p_srvr_salt);
 
 	bool is_connected_db();
+	/**
+	 * \brief				True while a transaction is open, or autocommit is off so the next statement opens one,
+	 *						from the status flags of the last server reply.
+	 */
+	bool is_in_transaction() const;
 
-	Variant query(const String& sql_stmt) { return _query(sql_stmt); }
-	void ping_srvr();
+	/**
+	 * \brief				A deadline_msec above 0 runs the statement under SET STATEMENT max_statement_time on
+	 *						MariaDB and kills it from a second session when no reply came shortly after the deadline,
+	 *						the call then fails with ERR_DEADLINE_EXCEEDED and the connection stays usable.
+	 */
+	Variant query(const String& sql_stmt, const uint32_t deadline_msec = 0) {
+		return _query(sql_stmt, false, deadline_msec);
+	}
+	/**
+	 * \brief				COM_PING, waits up to the server timeout for the reply. OK while the server answers,
+	 *						does not reconnect a lost connection.
+	 */
+	ErrorCode ping_srvr();
 	// Prepared statement section
 	Dictionary prepared_statement(const String& sql);
-	TypedArray<Dictionary> prepared_stmt_exec_select(uint32_t stmt_id, const TypedArray<Dictionary>& params);
-	// TypedArray<Dictionary> exec_prepped_select(uint32_t stmt_id, const Array &params);
-	Dictionary prepared_stmt_exec_cmd(uint32_t stmt_id, const TypedArray<Dictionary>& params);
+	/**
+	 * \brief				Params are plain values typed from the server parameter metadata, or the
+	 *						{FieldType: value} Dictionary form to force a wire type.
+	 */
+	TypedArray<Dictionary> prepared_stmt_exec_select(uint32_t stmt_id, const Array& params);
+	Dictionary prepared_stmt_exec_cmd(uint32_t stmt_id, const Array& params);
 	ErrorCode prepared_statement_close(uint32_t stmt_id);
+	/**
+	 * \brief				Prepares and executes a statement in a single round trip, the COM_STMT_EXECUTE,
+	 *						and the optional COM_STMT_CLOSE, are pipelined behind the COM_STMT_PREPARE.
+	 * \return 				Dictionary with "rows" for a result set or the OK packet values, and
+	 *						"statement_id" if the statement was kept open, also when only the execute failed.
+	 */
+	Dictionary prepare_and_execute(const String& sql, const Array& params, const bool close = true);
+	/**
+	 * \brief				Clears the session state with COM_RESET_CONNECTION, keeping the connection and user.
+	 *						Temporary tables, user variables, locks and prepared statements are released.
+	 * \return 				ErrorCode, OK on success.
+	 */
+	ErrorCode reset_session();
+	/**
+	 * \brief				Stats of the last login, "round_trips" exchanges after the TCP connect including
+	 *						init statements sent on their own, "usec" from connect to authenticated and the
+	 *						"auth_plugin" that completed it, and "reconnects" made automatically.
+	 */
+	Dictionary get_connect_stats() const;
 
-	TypedArray<Dictionary> select_query(const String& sql_stmt);
+	TypedArray<Dictionary> select_query(const String& sql_stmt, const uint32_t deadline_msec = 0);
+	uint32_t get_connection_id() const { return _connection_id; }
+	/**
+	 * \brief				Text protocol queries from a MariaDBQueryTemplate, the params are escaped and spliced
+	 *						into the pre-encoded SQL, one round trip without building the SQL String.
+	 */
+	Variant query_template(const Ref<MariaDBQueryTemplate>& sql_template, const Array& params);
+	TypedArray<Dictionary> select_template(const Ref<MariaDBQueryTemplate>& sql_template, const Array& params);
+	Dictionary execute_template(const Ref<MariaDBQueryTemplate>& sql_template, const Array& params);
 
 	//TODO(sigrudds1) Implement SSL/TLS
 	//void tls_enable(bool enable);
 
 	void set_dbl_to_string(bool is_to_str);
+	/**
+	 * \brief				Changes the default database, on an authenticated connection it is switched live with
+	 *						COM_INIT_DB, skipped when it already is the current one.
+	 */
 	void set_db_name(String p_db_name);
+	String get_db_name() const { return _current_db; }
+	/**
+	 * \brief				Statements run on every (re)authentication and reset_session, sent as one
+	 *						multi-statement packet pipelined behind the last auth packet when possible.
+	 */
+	void set_init_statements(const PackedStringArray& statements);
+	PackedStringArray get_init_statements() const { return _init_statements; }
+	/**
+	 * \brief				Adds last_gtid to the tracked session variables on every (re)authentication, the GTID of
+	 *						each committed write is then read from the OK packet without an extra query.
+	 */
+	void set_track_gtid(bool enable);
+	bool is_track_gtid() const { return _track_gtid; }
+	String get_last_gtid() const { return _last_gtid; }
 	void set_ip_type(IpType p_type);
 	void set_server_timeout(uint32_t msec = 1000) { _server_timout_msec = msec; }
+	/**
+	 * \brief				Limit for each TCP connect attempt, a candidate that has not connected by then is
+	 *						abandoned for the next one.
+	 */
+	void set_connect_timeout(uint32_t msec = 1000);
+	/**
+	 * \brief				When enabled a lost connection is re-established by the next call that needs it, with
+	 *						the init statements replayed and open prepared statements re-prepared under their
+	 *						existing handles. Failed attempts back off exponentially from base_msec up to max_msec
+	 *						with full jitter, calls inside the backoff window fail fast with ERR_NOT_CONNECTED.
+	 *						A command already sent when the connection drops is not retried.
+	 */
+	void set_auto_reconnect(bool enable, uint32_t base_msec = 100, uint32_t max_msec = 10000);
+	bool is_auto_reconnect() const { return _auto_reconnect; }
+	/**
+	 * \brief				Process wide token bucket for automatic reconnects of every connector, per_sec 0 removes
+	 *						the cap.
+	 */
+	static void set_reconnect_rate_limit(double per_sec = 100.0, int burst = 20);
+	/**
+	 * \brief				Hostnames are resolved through a process wide cache, an address is reused for ttl_sec
+	 *						and served for another stale_sec while it is refreshed in the background.
+	 */
+	static void set_dns_cache_ttl(uint32_t ttl_sec = 60, uint32_t stale_sec = 300);
+	static void prefetch_hostname(const String& hostname, IpType ip_type = IP_TYPE_ANY);
+	static void clear_dns_cache();
 	// TODO(sigrudds1) Async Callbacks signals
 
 	MariaDBConnector();
@@ -6,6 +6,7 @@ public:
 	enum AuthType {
 		AUTH_TYPE_ED25519,
 		AUTH_TYPE_MYSQL_NATIVE,
+		AUTH_TYPE_CACHING_SHA2,
 		AUTH_TYPE_LAST
 	};
 };
\ No newline at end of file
@@ -0,0 +1,158 @@
+/*************************************************************************/
+/*  mariadb_dns_cache.cpp                                                */
+/*************************************************************************/
+/*                     This file is part of the                          */
+/*                      MariaDBConnector addon                           */
+/*                    for use in the Godot Engine                        */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2021-2025 Shawn Shipton. https://vikingtinkerer.com     */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+#include "mariadb_dns_cache.hpp"
+
+#include <godot_cpp/classes/time.hpp>
+#include <godot_cpp/templates/hash_map.hpp>
+
+#include <mutex>
+
+namespace {
+
+struct DnsEntry {
+	String address;
+	// Served as is until expires, then stale while a refresh is pending, resolved in line after stale_until
+	uint64_t expires_msec = 0;
+	uint64_t stale_until_msec = 0;
+	int32_t pending_id = IP::RESOLVER_INVALID_ID;
+};
+
+// A failed refresh is retried after this long, serving the stale address meanwhile
+constexpr uint64_t kRetryMsec = 1000;
+
+std::mutex g_dns_mutex;
+HashMap<String, DnsEntry> g_dns_entries;
+uint64_t g_ttl_msec = 60000;
+uint64_t g_stale_msec = 300000;
+
+String entry_key(const String &p_host, IP::Type p_ip_type) { return p_host + "|" + itos(p_ip_type); }
+
+void store_address(DnsEntry &r_entry, const String &p_address, uint64_t p_now_msec) {
+	r_entry.address = p_address;
+	r_entry.expires_msec = p_now_msec + g_ttl_msec;
+	r_entry.stale_until_msec = r_entry.expires_msec + g_stale_msec;
+}
+
+// Collects a finished background resolution, the queue slot is released either way
+void poll_pending(DnsEntry &r_entry, uint64_t p_now_msec) {
+	if (r_entry.pending_id == IP::RESOLVER_INVALID_ID) return;
+
+	IP *ip = IP::get_singleton();
+	const IP::ResolverStatus status = ip->get_resolve_item_status(r_entry.pending_id);
+	if (status == IP::RESOLVER_STATUS_WAITING) return;
+
+	if (status == IP::RESOLVER_STATUS_DONE) {
+		const String address = ip->get_resolve_item_address(r_entry.pending_id);
+		if (address.is_valid_ip_address()) {
+			store_address(r_entry, address, p_now_msec);
+		} else {
+			r_entry.expires_msec = p_now_msec + kRetryMsec;
+		}
+	} else {
+		r_entry.expires_msec = p_now_msec + kRetryMsec;
+	}
+	ip->erase_resolve_item(r_entry.pending_id);
+	r_entry.pending_id = IP::RESOLVER_INVALID_ID;
+}
+
+void queue_refresh(const String &p_host, IP::Type p_ip_type, DnsEntry &r_entry) {
+	if (r_entry.pending_id != IP::RESOLVER_INVALID_ID) return;
+	IP *ip = IP::get_singleton();
+	// Godot keeps its own resolved addresses forever, drop it so the query reaches the resolver
+	ip->clear_cache(p_host);
+	r_entry.pending_id = ip->resolve_hostname_queue_item(p_host, p_ip_type);
+}
+
+}  // namespace
+
+String MariaDBDnsCache::resolve(const String &p_host, IP::Type p_ip_type) {
+	if (p_host.is_valid_ip_address()) return p_host;
+
+	const String key = entry_key(p_host, p_ip_type);
+	String stale_address;
+	{
+		std::lock_guard<std::mutex> lock(g_dns_mutex);
+		const uint64_t now_msec = Time::get_singleton()->get_ticks_msec();
+		DnsEntry *entry = g_dns_entries.getptr(key);
+		if (entry) {
+			poll_pending(*entry, now_msec);
+			// A prefetch still pending has no address yet
+			if (!entry->address.is_empty()) {
+				if (now_msec < entry->expires_msec) return entry->address;
+				if (now_msec < entry->stale_until_msec) {
+					queue_refresh(p_host, p_ip_type, *entry);
+					return entry->address;
+				}
+				stale_address = entry->address;
+			}
+		}
+	}
+
+	// First use, or stale for too long, resolved in line without holding the lock
+	IP *ip = IP::get_singleton();
+	ip->clear_cache(p_host);
+	const String address = ip->resolve_hostname(p_host, p_ip_type);
+
+	std::lock_guard<std::mutex> lock(g_dns_mutex);
+	const uint64_t now_msec = Time::get_singleton()->get_ticks_msec();
+	if (!address.is_valid_ip_address()) {
+		// Serving the last known address beats failing while the resolver is down
+		return stale_address;
+	}
+	DnsEntry &entry = g_dns_entries[key];
+	store_address(entry, address, now_msec);
+	return address;
+}
+
+void MariaDBDnsCache::prefetch(const String &p_host, IP::Type p_ip_type) {
+	if (p_host.is_valid_ip_address()) return;
+
+	std::lock_guard<std::mutex> lock(g_dns_mutex);
+	const uint64_t now_msec = Time::get_singleton()->get_ticks_msec();
+	DnsEntry &entry = g_dns_entries[entry_key(p_host, p_ip_type)];
+	poll_pending(entry, now_msec);
+	if (now_msec >= entry.expires_msec) queue_refresh(p_host, p_ip_type, entry);
+}
+
+void MariaDBDnsCache::set_ttl(uint32_t p_ttl_msec, uint32_t p_stale_msec) {
+	std::lock_guard<std::mutex> lock(g_dns_mutex);
+	g_ttl_msec = p_ttl_msec;
+	g_stale_msec = p_stale_msec;
+}
+
+void MariaDBDnsCache::clear() {
+	std::lock_guard<std::mutex> lock(g_dns_mutex);
+	for (KeyValue<String, DnsEntry> &kv : g_dns_entries) {
+		if (kv.value.pending_id == IP::RESOLVER_INVALID_ID) continue;
+		IP::get_singleton()->erase_resolve_item(kv.value.pending_id);
+	}
+	g_dns_entries.clear();
+}
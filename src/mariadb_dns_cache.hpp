@@ -0,0 +1,58 @@
+/*************************************************************************/
+/*  mariadb_dns_cache.hpp                                                */
+/*************************************************************************/
+/*                     This file is part of the                          */
+/*                      MariaDBConnector addon                           */
+/*                    for use in the Godot Engine                        */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2021-2025 Shawn Shipton. https://vikingtinkerer.com     */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+#pragma once
+
+#include <godot_cpp/classes/ip.hpp>
+#include <godot_cpp/variant/string.hpp>
+
+#include <cstdint>
+
+using namespace godot;
+
+/**
+ * \brief		Process wide hostname cache shared by every connector. Addresses are kept for a TTL, once expired
+ *				the old address keeps being served while a refresh runs on Godot's IP resolver queue, only a
+ *				hostname never seen, or stale beyond the stale window, is resolved synchronously.
+ */
+class MariaDBDnsCache {
+public:
+	/**
+	 * \brief		Address for the hostname, IP addresses are returned unchanged. Empty if it can't be resolved
+	 *				and no earlier address is cached.
+	 */
+	static String resolve(const String &p_host, IP::Type p_ip_type);
+	/**
+	 * \brief		Queues a resolution in the background without waiting, so a later resolve() is a cache hit.
+	 */
+	static void prefetch(const String &p_host, IP::Type p_ip_type);
+	static void set_ttl(uint32_t p_ttl_msec, uint32_t p_stale_msec);
+	static void clear();
+};
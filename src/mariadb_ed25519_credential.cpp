@@ -0,0 +1,192 @@
+/*************************************************************************/
+/*  mariadb_ed25519_credential.cpp                                         */
+/*************************************************************************/
+/*                     This file is part of the                          */
+/*                      MariaDBConnector addon                           */
+/*                    for use in the Godot Engine                        */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2021-2025 Shawn Shipton. https://vikingtinkerer.com     */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+#include "mariadb_ed25519_credential.hpp"
+
+#include "ed25519_ref10/ed25519_auth.h"
+#include "ed25519_ref10/ge.h"
+#include "ed25519_ref10/sc.h"
+#include "mariadb_ed25519_fe51.hpp"
+#include "mbedtls/platform_util.h"
+#include "mbedtls/sha512.h"
+
+#include <godot_cpp/core/error_macros.hpp>
+
+#include <cstring>
+#include <mutex>
+
+namespace {
+
+typedef void (*ScalarmultBaseFn)(uint8_t *r_point, const uint8_t *p_scalar);
+
+void ref10_scalarmult_base(uint8_t *r_point, const uint8_t *p_scalar) {
+	ge_p3 point;
+	ge_scalarmult_base(&point, p_scalar);
+	ge_p3_tobytes(r_point, &point);
+}
+
+ScalarmultBaseFn g_scalarmult_base = ref10_scalarmult_base;
+const char *g_backend_name = "ref10";
+std::once_flag g_backend_once;
+
+void clamp_secret(uint8_t *r_az) {
+	r_az[0] &= 248;
+	r_az[31] &= 63;
+	r_az[31] |= 64;
+}
+
+void sign_with(ScalarmultBaseFn p_scalarmult_base,
+		const uint8_t *p_az,
+		const uint8_t *p_pk,
+		const uint8_t *p_msg,
+		const size_t p_msg_len,
+		uint8_t *r_sig) {
+	uint8_t nonce[64];
+	uint8_t hram[64];
+	mbedtls_sha512_context ctx;
+	mbedtls_sha512_init(&ctx);
+
+	// r = H(prefix || M)
+	mbedtls_sha512_starts(&ctx, 0);
+	mbedtls_sha512_update(&ctx, p_az + 32, 32);
+	mbedtls_sha512_update(&ctx, p_msg, p_msg_len);
+	mbedtls_sha512_finish(&ctx, nonce);
+	sc_reduce(nonce);
+
+	// R = rB
+	p_scalarmult_base(r_sig, nonce);
+
+	// S = (r + H(R || A || M) a) mod l
+	mbedtls_sha512_starts(&ctx, 0);
+	mbedtls_sha512_update(&ctx, r_sig, 32);
+	mbedtls_sha512_update(&ctx, p_pk, 32);
+	mbedtls_sha512_update(&ctx, p_msg, p_msg_len);
+	mbedtls_sha512_finish(&ctx, hram);
+	sc_reduce(hram);
+	sc_muladd(r_sig + 32, hram, p_az, nonce);
+
+	mbedtls_sha512_free(&ctx);
+	mbedtls_platform_zeroize(nonce, sizeof(nonce));
+}
+
+// The faster backend is only used once it reproduces ref10 byte for byte on this machine, the public keys and
+// the full signatures of ed25519_sign_msg for a few derived password hashes.
+bool backend_matches_ref10(ScalarmultBaseFn p_scalarmult_base) {
+	uint8_t pw_sha512[64];
+	uint8_t az[64];
+	uint8_t pk[32];
+	uint8_t msg[64];
+	uint8_t expected[Ed25519Credential::kSignatureBytes];
+	uint8_t actual[Ed25519Credential::kSignatureBytes];
+
+	for (uint8_t i = 0; i < 4; i++) {
+		const uint8_t seed[2] = { 0xED, i };
+		mbedtls_sha512(seed, sizeof(seed), pw_sha512, 0);
+		mbedtls_sha512(pw_sha512, sizeof(pw_sha512), msg, 0);
+		memcpy(az, pw_sha512, sizeof(az));
+		clamp_secret(az);
+
+		ref10_scalarmult_base(expected, az);
+		p_scalarmult_base(pk, az);
+		if (memcmp(expected, pk, sizeof(pk)) != 0) return false;
+
+		ed25519_sign_msg(pw_sha512, msg, 32, expected);
+		sign_with(p_scalarmult_base, az, pk, msg, 32, actual);
+		if (memcmp(expected, actual, sizeof(actual)) != 0) return false;
+	}
+	return true;
+}
+
+void select_backend() {
+#if MARIADB_ED25519_FE51
+	if (backend_matches_ref10(ed25519_fe51_scalarmult_base)) {
+		g_scalarmult_base = ed25519_fe51_scalarmult_base;
+		g_backend_name = "fe51";
+	} else {
+		ERR_PRINT("ed25519 fe51 backend does not match ref10, falling back to ref10");
+	}
+#endif
+}
+
+void scalarmult_base(uint8_t *r_point, const uint8_t *p_scalar) {
+	std::call_once(g_backend_once, select_backend);
+	g_scalarmult_base(r_point, p_scalar);
+}
+
+}  // namespace
+
+Ed25519Credential::Ed25519Credential(const uint8_t *p_pw_sha512) {
+	// MariaDB client_ed25519 uses the SHA-512 of the password as the expanded secret key
+	memcpy(_az, p_pw_sha512, sizeof(_az));
+	clamp_secret(_az);
+
+	// A = aB, the scalar multiplication every signature used to repeat
+	scalarmult_base(_pk, _az);
+}
+
+Ed25519Credential::~Ed25519Credential() {
+	mbedtls_platform_zeroize(_az, sizeof(_az));
+}
+
+void Ed25519Credential::sign(const uint8_t *p_msg, const size_t p_msg_len, uint8_t *r_sig) const {
+	sign_with(scalarmult_base, _az, _pk, p_msg, p_msg_len, r_sig);
+}
+
+PackedByteArray Ed25519Credential::sign(const PackedByteArray &p_msg) const {
+	PackedByteArray sig;
+	sig.resize(kSignatureBytes);
+	sign(p_msg.ptr(), p_msg.size(), sig.ptrw());
+	return sig;
+}
+
+const char *Ed25519Credential::backend() {
+	std::call_once(g_backend_once, select_backend);
+	return g_backend_name;
+}
+
+PackedByteArray Ed25519Credential::hash_password(const String &p_password) {
+	PackedByteArray hashed;
+	hashed.resize(64);
+
+	CharString password_utf8 = p_password.utf8();
+	mbedtls_sha512_context ctx;
+	mbedtls_sha512_init(&ctx);
+	mbedtls_sha512_starts(&ctx, 0);
+	mbedtls_sha512_update(&ctx, reinterpret_cast<const uint8_t *>(password_utf8.get_data()), password_utf8.length());
+	mbedtls_sha512_finish(&ctx, hashed.ptrw());
+	mbedtls_sha512_free(&ctx);
+
+	return hashed;
+}
+
+std::shared_ptr<const Ed25519Credential> Ed25519Credential::create(const PackedByteArray &p_pw_sha512) {
+	if (p_pw_sha512.size() != 64) return nullptr;
+	return std::make_shared<const Ed25519Credential>(p_pw_sha512.ptr());
+}
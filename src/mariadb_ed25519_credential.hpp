@@ -0,0 +1,77 @@
+/*************************************************************************/
+/*  mariadb_ed25519_credential.hpp                                         */
+/*************************************************************************/
+/*                     This file is part of the                          */
+/*                      MariaDBConnector addon                           */
+/*                    for use in the Godot Engine                        */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2021-2025 Shawn Shipton. https://vikingtinkerer.com     */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+#pragma once
+
+#include <godot_cpp/variant/packed_byte_array.hpp>
+#include <godot_cpp/variant/string.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+using namespace godot;
+
+/**
+ * \brief		client_ed25519 key material derived once from the SHA-512 password hash, the clamped secret
+ *				scalar, nonce prefix and public key. Immutable after construction so a single instance can be
+ *				shared by every connection using the same credentials, the secret is zeroized on destruction.
+ */
+class Ed25519Credential {
+public:
+	static constexpr size_t kSignatureBytes = 64;
+
+	explicit Ed25519Credential(const uint8_t *p_pw_sha512);
+	~Ed25519Credential();
+	Ed25519Credential(const Ed25519Credential &) = delete;
+	Ed25519Credential &operator=(const Ed25519Credential &) = delete;
+
+	/**
+	 * \brief		Same signature as ed25519_sign_msg with the same password hash, without deriving the public
+	 *				key again.
+	 */
+	void sign(const uint8_t *p_msg, const size_t p_msg_len, uint8_t *r_sig) const;
+	PackedByteArray sign(const PackedByteArray &p_msg) const;
+
+	/**
+	 * \brief		Field arithmetic used for the base point multiplications, "fe51" when the 64 bit backend is
+	 *				available and passed its self test against ref10 on first use, otherwise "ref10".
+	 */
+	static const char *backend();
+	static PackedByteArray hash_password(const String &p_password);
+	static std::shared_ptr<const Ed25519Credential> create(const PackedByteArray &p_pw_sha512);
+
+private:
+	// az[0..31] clamped secret scalar a, az[32..63] nonce prefix
+	uint8_t _az[64];
+	uint8_t _pk[32];
+};
+
+using Ed25519CredentialPtr = std::shared_ptr<const Ed25519Credential>;
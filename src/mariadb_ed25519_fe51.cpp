@@ -0,0 +1,442 @@
+/*************************************************************************/
+/*  mariadb_ed25519_fe51.cpp                                             */
+/*************************************************************************/
+/*                     This file is part of the                          */
+/*                      MariaDBConnector addon                           */
+/*                    for use in the Godot Engine                        */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2021-2025 Shawn Shipton. https://vikingtinkerer.com     */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+#include "mariadb_ed25519_fe51.hpp"
+
+#if MARIADB_ED25519_FE51
+
+#include <cstring>
+#include <mutex>
+
+// Same group formulas and signed radix 16 base table as ref10, the speed comes from the field representation.
+// ref10 keeps ten 25.5 bit limbs multiplied 32x32->64, here five 51 bit limbs use a quarter of the multiplies.
+
+namespace {
+
+typedef unsigned __int128 u128;
+typedef uint64_t fe51[5];
+
+constexpr uint64_t kMask51 = (uint64_t(1) << 51) - 1;
+
+// 2 * d, d = -121665/121666
+const fe51 kD2 = { 0x69b9426b2f159, 0x35050762add7a, 0x3cf44c0038052, 0x6738cc7407977, 0x2406d9dc56dff };
+// Base point B
+const fe51 kBx = { 0x62d608f25d51a, 0x412a4b4f6592a, 0x75b7171a4b31d, 0x1ff60527118fe, 0x216936d3cd6e5 };
+const fe51 kBy = { 0x6666666666658, 0x4cccccccccccc, 0x1999999999999, 0x3333333333333, 0x6666666666666 };
+
+struct GeP2 {
+	fe51 X, Y, Z;
+};
+struct GeP3 {
+	fe51 X, Y, Z, T;
+};
+struct GeP1P1 {
+	fe51 X, Y, Z, T;
+};
+struct GePrecomp {
+	fe51 yplusx, yminusx, xy2d;
+};
+struct GeCached {
+	fe51 YplusX, YminusX, Z, T2d;
+};
+
+// base[i][j] = (j + 1) * 256^i * B, built once on first use instead of shipping ref10's generated table
+GePrecomp g_base[32][8];
+std::once_flag g_base_once;
+
+inline void fe_0(fe51 h) { memset(h, 0, sizeof(fe51)); }
+
+inline void fe_1(fe51 h) {
+	fe_0(h);
+	h[0] = 1;
+}
+
+inline void fe_copy(fe51 h, const fe51 f) { memcpy(h, f, sizeof(fe51)); }
+
+// Limbs back under 2^51, h[0] may keep a small excess
+inline void fe_carry(fe51 h) {
+	h[1] += h[0] >> 51;
+	h[0] &= kMask51;
+	h[2] += h[1] >> 51;
+	h[1] &= kMask51;
+	h[3] += h[2] >> 51;
+	h[2] &= kMask51;
+	h[4] += h[3] >> 51;
+	h[3] &= kMask51;
+	h[0] += 19 * (h[4] >> 51);
+	h[4] &= kMask51;
+}
+
+inline void fe_add(fe51 h, const fe51 f, const fe51 g) {
+	for (int i = 0; i < 5; i++) h[i] = f[i] + g[i];
+	fe_carry(h);
+}
+
+// Adds 4p first so the carried limbs of g never underflow
+inline void fe_sub(fe51 h, const fe51 f, const fe51 g) {
+	h[0] = f[0] + 0x1FFFFFFFFFFFB4 - g[0];
+	h[1] = f[1] + 0x1FFFFFFFFFFFFC - g[1];
+	h[2] = f[2] + 0x1FFFFFFFFFFFFC - g[2];
+	h[3] = f[3] + 0x1FFFFFFFFFFFFC - g[3];
+	h[4] = f[4] + 0x1FFFFFFFFFFFFC - g[4];
+	fe_carry(h);
+}
+
+inline void fe_neg(fe51 h, const fe51 f) {
+	fe51 zero;
+	fe_0(zero);
+	fe_sub(h, zero, f);
+}
+
+inline void fe_reduce_wide(fe51 h, u128 r0, u128 r1, u128 r2, u128 r3, u128 r4) {
+	r1 += r0 >> 51;
+	r2 += r1 >> 51;
+	r3 += r2 >> 51;
+	r4 += r3 >> 51;
+	h[0] = ((uint64_t)r0 & kMask51) + 19 * (uint64_t)(r4 >> 51);
+	h[1] = ((uint64_t)r1 & kMask51) + (h[0] >> 51);
+	h[0] &= kMask51;
+	h[2] = (uint64_t)r2 & kMask51;
+	h[3] = (uint64_t)r3 & kMask51;
+	h[4] = (uint64_t)r4 & kMask51;
+}
+
+void fe_mul(fe51 h, const fe51 f, const fe51 g) {
+	const uint64_t f0 = f[0], f1 = f[1], f2 = f[2], f3 = f[3], f4 = f[4];
+	const uint64_t g0 = g[0], g1 = g[1], g2 = g[2], g3 = g[3], g4 = g[4];
+	// 2^255 = 19 mod p, limb products past the fifth limb fold back multiplied by 19
+	const uint64_t g1_19 = 19 * g1, g2_19 = 19 * g2, g3_19 = 19 * g3, g4_19 = 19 * g4;
+
+	u128 r0 = (u128)f0 * g0 + (u128)f1 * g4_19 + (u128)f2 * g3_19 + (u128)f3 * g2_19 + (u128)f4 * g1_19;
+	u128 r1 = (u128)f0 * g1 + (u128)f1 * g0 + (u128)f2 * g4_19 + (u128)f3 * g3_19 + (u128)f4 * g2_19;
+	u128 r2 = (u128)f0 * g2 + (u128)f1 * g1 + (u128)f2 * g0 + (u128)f3 * g4_19 + (u128)f4 * g3_19;
+	u128 r3 = (u128)f0 * g3 + (u128)f1 * g2 + (u128)f2 * g1 + (u128)f3 * g0 + (u128)f4 * g4_19;
+	u128 r4 = (u128)f0 * g4 + (u128)f1 * g3 + (u128)f2 * g2 + (u128)f3 * g1 + (u128)f4 * g0;
+	fe_reduce_wide(h, r0, r1, r2, r3, r4);
+}
+
+void fe_sq(fe51 h, const fe51 f) {
+	const uint64_t f0 = f[0], f1 = f[1], f2 = f[2], f3 = f[3], f4 = f[4];
+	const uint64_t f0_2 = 2 * f0, f1_2 = 2 * f1;
+	const uint64_t f1_38 = 38 * f1, f2_38 = 38 * f2, f3_38 = 38 * f3;
+	const uint64_t f3_19 = 19 * f3, f4_19 = 19 * f4;
+
+	u128 r0 = (u128)f0 * f0 + (u128)f1_38 * f4 + (u128)f2_38 * f3;
+	u128 r1 = (u128)f0_2 * f1 + (u128)f2_38 * f4 + (u128)f3_19 * f3;
+	u128 r2 = (u128)f0_2 * f2 + (u128)f1 * f1 + (u128)f3_38 * f4;
+	u128 r3 = (u128)f0_2 * f3 + (u128)f1_2 * f2 + (u128)f4_19 * f4;
+	u128 r4 = (u128)f0_2 * f4 + (u128)f1_2 * f3 + (u128)f2 * f2;
+	fe_reduce_wide(h, r0, r1, r2, r3, r4);
+}
+
+void fe_sq_n(fe51 h, const fe51 f, int n) {
+	fe_sq(h, f);
+	for (int i = 1; i < n; i++) fe_sq(h, h);
+}
+
+// z^(p - 2), same addition chain as ref10 fe_invert
+void fe_invert(fe51 out, const fe51 z) {
+	fe51 t0, t1, t2, t3;
+	fe_sq(t0, z);
+	fe_sq_n(t1, t0, 2);
+	fe_mul(t1, z, t1);
+	fe_mul(t0, t0, t1);
+	fe_sq(t2, t0);
+	fe_mul(t1, t1, t2);
+	fe_sq_n(t2, t1, 5);
+	fe_mul(t1, t2, t1);
+	fe_sq_n(t2, t1, 10);
+	fe_mul(t2, t2, t1);
+	fe_sq_n(t3, t2, 20);
+	fe_mul(t2, t3, t2);
+	fe_sq_n(t2, t2, 10);
+	fe_mul(t1, t2, t1);
+	fe_sq_n(t2, t1, 50);
+	fe_mul(t2, t2, t1);
+	fe_sq_n(t3, t2, 100);
+	fe_mul(t2, t3, t2);
+	fe_sq_n(t2, t2, 50);
+	fe_mul(t1, t2, t1);
+	fe_sq_n(t1, t1, 5);
+	fe_mul(out, t1, t0);
+}
+
+void fe_tobytes(uint8_t *s, const fe51 f) {
+	fe51 h;
+	fe_copy(h, f);
+	fe_carry(h);
+	fe_carry(h);
+
+	// h < 2p here, q is 1 when h >= p
+	uint64_t q = (h[0] + 19) >> 51;
+	q = (h[1] + q) >> 51;
+	q = (h[2] + q) >> 51;
+	q = (h[3] + q) >> 51;
+	q = (h[4] + q) >> 51;
+
+	h[0] += 19 * q;
+	h[1] += h[0] >> 51;
+	h[0] &= kMask51;
+	h[2] += h[1] >> 51;
+	h[1] &= kMask51;
+	h[3] += h[2] >> 51;
+	h[2] &= kMask51;
+	h[4] += h[3] >> 51;
+	h[3] &= kMask51;
+	h[4] &= kMask51;
+
+	const uint64_t w[4] = { h[0] | (h[1] << 51), (h[1] >> 13) | (h[2] << 38), (h[2] >> 26) | (h[3] << 25),
+		(h[3] >> 39) | (h[4] << 12) };
+	for (int i = 0; i < 4; i++) {
+		for (int j = 0; j < 8; j++) s[i * 8 + j] = (uint8_t)(w[i] >> (8 * j));
+	}
+}
+
+inline int fe_isnegative(const fe51 f) {
+	uint8_t s[32];
+	fe_tobytes(s, f);
+	return s[0] & 1;
+}
+
+// Constant time f = b ? g : f
+inline void fe_cmov(fe51 f, const fe51 g, unsigned int b) {
+	const uint64_t mask = 0 - (uint64_t)b;
+	for (int i = 0; i < 5; i++) f[i] ^= mask & (f[i] ^ g[i]);
+}
+
+void ge_p3_0(GeP3 &h) {
+	fe_0(h.X);
+	fe_1(h.Y);
+	fe_1(h.Z);
+	fe_0(h.T);
+}
+
+void ge_precomp_0(GePrecomp &h) {
+	fe_1(h.yplusx);
+	fe_1(h.yminusx);
+	fe_0(h.xy2d);
+}
+
+void ge_p1p1_to_p2(GeP2 &r, const GeP1P1 &p) {
+	fe_mul(r.X, p.X, p.T);
+	fe_mul(r.Y, p.Y, p.Z);
+	fe_mul(r.Z, p.Z, p.T);
+}
+
+void ge_p1p1_to_p3(GeP3 &r, const GeP1P1 &p) {
+	fe_mul(r.X, p.X, p.T);
+	fe_mul(r.Y, p.Y, p.Z);
+	fe_mul(r.Z, p.Z, p.T);
+	fe_mul(r.T, p.X, p.Y);
+}
+
+void ge_p3_to_cached(GeCached &r, const GeP3 &p) {
+	fe_add(r.YplusX, p.Y, p.X);
+	fe_sub(r.YminusX, p.Y, p.X);
+	fe_copy(r.Z, p.Z);
+	fe_mul(r.T2d, p.T, kD2);
+}
+
+void ge_p2_dbl(GeP1P1 &r, const GeP2 &p) {
+	fe51 t0;
+	fe_sq(r.X, p.X);
+	fe_sq(r.Z, p.Y);
+	fe_sq(r.T, p.Z);
+	fe_add(r.T, r.T, r.T);
+	fe_add(r.Y, p.X, p.Y);
+	fe_sq(t0, r.Y);
+	fe_add(r.Y, r.Z, r.X);
+	fe_sub(r.Z, r.Z, r.X);
+	fe_sub(r.X, t0, r.Y);
+	fe_sub(r.T, r.T, r.Z);
+}
+
+void ge_p3_dbl(GeP1P1 &r, const GeP3 &p) {
+	GeP2 q;
+	fe_copy(q.X, p.X);
+	fe_copy(q.Y, p.Y);
+	fe_copy(q.Z, p.Z);
+	ge_p2_dbl(r, q);
+}
+
+void ge_add(GeP1P1 &r, const GeP3 &p, const GeCached &q) {
+	fe51 t0;
+	fe_add(r.X, p.Y, p.X);
+	fe_sub(r.Y, p.Y, p.X);
+	fe_mul(r.Z, r.X, q.YplusX);
+	fe_mul(r.Y, r.Y, q.YminusX);
+	fe_mul(r.T, q.T2d, p.T);
+	fe_mul(r.X, p.Z, q.Z);
+	fe_add(t0, r.X, r.X);
+	fe_sub(r.X, r.Z, r.Y);
+	fe_add(r.Y, r.Z, r.Y);
+	fe_add(r.Z, t0, r.T);
+	fe_sub(r.T, t0, r.T);
+}
+
+void ge_madd(GeP1P1 &r, const GeP3 &p, const GePrecomp &q) {
+	fe51 t0;
+	fe_add(r.X, p.Y, p.X);
+	fe_sub(r.Y, p.Y, p.X);
+	fe_mul(r.Z, r.X, q.yplusx);
+	fe_mul(r.Y, r.Y, q.yminusx);
+	fe_mul(r.T, q.xy2d, p.T);
+	fe_add(t0, p.Z, p.Z);
+	fe_sub(r.X, r.Z, r.Y);
+	fe_add(r.Y, r.Z, r.Y);
+	fe_add(r.Z, t0, r.T);
+	fe_sub(r.T, t0, r.T);
+}
+
+void ge_p3_tobytes(uint8_t *s, const GeP3 &h) {
+	fe51 recip, x, y;
+	fe_invert(recip, h.Z);
+	fe_mul(x, h.X, recip);
+	fe_mul(y, h.Y, recip);
+	fe_tobytes(s, y);
+	s[31] ^= fe_isnegative(x) << 7;
+}
+
+void ge_p3_to_precomp(GePrecomp &r, const GeP3 &p) {
+	fe51 recip, x, y, xy;
+	fe_invert(recip, p.Z);
+	fe_mul(x, p.X, recip);
+	fe_mul(y, p.Y, recip);
+	fe_add(r.yplusx, y, x);
+	fe_sub(r.yminusx, y, x);
+	fe_mul(xy, x, y);
+	fe_mul(r.xy2d, xy, kD2);
+}
+
+void build_base_table() {
+	GeP3 step;
+	fe_copy(step.X, kBx);
+	fe_copy(step.Y, kBy);
+	fe_1(step.Z);
+	fe_mul(step.T, kBx, kBy);
+
+	for (int i = 0; i < 32; i++) {
+		GeCached step_cached;
+		ge_p3_to_cached(step_cached, step);
+		GeP3 multiple = step;
+		for (int j = 0; j < 8; j++) {
+			ge_p3_to_precomp(g_base[i][j], multiple);
+			GeP1P1 sum;
+			ge_add(sum, multiple, step_cached);
+			ge_p1p1_to_p3(multiple, sum);
+		}
+		for (int k = 0; k < 8; k++) {
+			GeP1P1 dbl;
+			ge_p3_dbl(dbl, step);
+			ge_p1p1_to_p3(step, dbl);
+		}
+	}
+}
+
+inline unsigned int ct_equal(int8_t b, int8_t c) {
+	uint32_t y = (uint8_t)(b ^ c);
+	y -= 1;
+	return y >> 31;
+}
+
+inline unsigned int ct_negative(int8_t b) { return (uint64_t)(int64_t)b >> 63; }
+
+// Constant time t = b * base[pos], b in [-8, 8]
+void ge_select(GePrecomp &t, int pos, int8_t b) {
+	const unsigned int b_negative = ct_negative(b);
+	const int8_t b_abs = b - (int8_t)(((-(int)b_negative) & b) * 2);
+
+	ge_precomp_0(t);
+	for (int j = 0; j < 8; j++) {
+		const unsigned int hit = ct_equal(b_abs, j + 1);
+		fe_cmov(t.yplusx, g_base[pos][j].yplusx, hit);
+		fe_cmov(t.yminusx, g_base[pos][j].yminusx, hit);
+		fe_cmov(t.xy2d, g_base[pos][j].xy2d, hit);
+	}
+
+	GePrecomp minus_t;
+	fe_copy(minus_t.yplusx, t.yminusx);
+	fe_copy(minus_t.yminusx, t.yplusx);
+	fe_neg(minus_t.xy2d, t.xy2d);
+	fe_cmov(t.yplusx, minus_t.yplusx, b_negative);
+	fe_cmov(t.yminusx, minus_t.yminusx, b_negative);
+	fe_cmov(t.xy2d, minus_t.xy2d, b_negative);
+}
+
+}  // namespace
+
+void ed25519_fe51_scalarmult_base(uint8_t *r_point, const uint8_t *p_scalar) {
+	std::call_once(g_base_once, build_base_table);
+
+	// Signed radix 16 digits, e[63] is at most 8 because p_scalar[31] <= 127
+	int8_t e[64];
+	for (int i = 0; i < 32; i++) {
+		e[2 * i] = p_scalar[i] & 15;
+		e[2 * i + 1] = (p_scalar[i] >> 4) & 15;
+	}
+	int8_t carry = 0;
+	for (int i = 0; i < 63; i++) {
+		e[i] += carry;
+		carry = (e[i] + 8) >> 4;
+		e[i] -= carry * 16;
+	}
+	e[63] += carry;
+
+	GeP3 h;
+	GeP1P1 r;
+	GeP2 s;
+	GePrecomp t;
+
+	ge_p3_0(h);
+	for (int i = 1; i < 64; i += 2) {
+		ge_select(t, i / 2, e[i]);
+		ge_madd(r, h, t);
+		ge_p1p1_to_p3(h, r);
+	}
+
+	ge_p3_dbl(r, h);
+	ge_p1p1_to_p2(s, r);
+	ge_p2_dbl(r, s);
+	ge_p1p1_to_p2(s, r);
+	ge_p2_dbl(r, s);
+	ge_p1p1_to_p2(s, r);
+	ge_p2_dbl(r, s);
+	ge_p1p1_to_p3(h, r);
+
+	for (int i = 0; i < 64; i += 2) {
+		ge_select(t, i / 2, e[i]);
+		ge_madd(r, h, t);
+		ge_p1p1_to_p3(h, r);
+	}
+
+	ge_p3_tobytes(r_point, h);
+}
+
+#endif  // MARIADB_ED25519_FE51
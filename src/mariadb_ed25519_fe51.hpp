@@ -0,0 +1,49 @@
+/*************************************************************************/
+/*  mariadb_ed25519_fe51.hpp                                             */
+/*************************************************************************/
+/*                     This file is part of the                          */
+/*                      MariaDBConnector addon                           */
+/*                    for use in the Godot Engine                        */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2021-2025 Shawn Shipton. https://vikingtinkerer.com     */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+#pragma once
+
+#include <cstdint>
+
+#if defined(__SIZEOF_INT128__)
+#define MARIADB_ED25519_FE51 1
+#else
+#define MARIADB_ED25519_FE51 0
+#endif
+
+/**
+ * \brief		Fixed base scalar multiplication A = aB on edwards25519 with the field in five 51 bit limbs and
+ *				64x64->128 bit multiplies, encoded like ref10 ge_scalarmult_base followed by ge_p3_tobytes.
+ *				Constant time in the scalar. Only compiled in when the compiler provides a 128 bit integer,
+ *				guard calls with MARIADB_ED25519_FE51.
+ * \param r_point	32 byte encoded point out.
+ * \param p_scalar	32 byte little endian scalar, p_scalar[31] <= 127.
+ */
+void ed25519_fe51_scalarmult_base(uint8_t *r_point, const uint8_t *p_scalar);
@@ -0,0 +1,226 @@
+/*************************************************************************/
+/*  mariadb_query_template.cpp                                           */
+/*************************************************************************/
+/*                     This file is part of the                          */
+/*                      MariaDBConnector addon                           */
+/*                    for use in the Godot Engine                        */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2021-2025 Shawn Shipton. https://vikingtinkerer.com     */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+#include "mariadb_query_template.hpp"
+
+#include <godot_cpp/core/error_macros.hpp>
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+void MariaDBQueryTemplate::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("set_sql", "sql"), &MariaDBQueryTemplate::set_sql);
+	ClassDB::bind_method(D_METHOD("get_sql"), &MariaDBQueryTemplate::get_sql);
+	ClassDB::bind_method(D_METHOD("get_param_count", "no_backslash_escapes"),
+			&MariaDBQueryTemplate::get_param_count,
+			DEFVAL(false));
+	ClassDB::bind_method(
+			D_METHOD("is_valid", "no_backslash_escapes"), &MariaDBQueryTemplate::is_valid, DEFVAL(false));
+	ClassDB::bind_method(D_METHOD("render", "params", "no_backslash_escapes"),
+			&MariaDBQueryTemplate::render,
+			DEFVAL(false));
+
+	ADD_PROPERTY(PropertyInfo(Variant::STRING, "sql"), "set_sql", "get_sql");
+}
+
+void MariaDBQueryTemplate::set_sql(const String &p_sql) {
+	_sql = p_sql;
+	_sql_utf8 = p_sql.to_utf8_buffer();
+	// Whether \ escapes a quote depends on the sql_mode at execution time, so both splits are kept
+	_valid = _parse(false, _placeholders);
+	_valid_nbe = _parse(true, _placeholders_nbe);
+	if (!_valid && !_valid_nbe) {
+		ERR_PRINT(vformat("Unterminated quote or comment in query template: %s", p_sql));
+	}
+}
+
+bool MariaDBQueryTemplate::_parse(const bool p_no_backslash_escapes, PackedInt64Array &r_placeholders) const {
+	r_placeholders.clear();
+
+	// Only ? outside of quoted strings, quoted identifiers and comments are placeholders.
+	const uint8_t *src = _sql_utf8.ptr();
+	const int64_t len = _sql_utf8.size();
+	int64_t i = 0;
+	while (i < len) {
+		const uint8_t c = src[i];
+		if (c == '\'' || c == '"' || c == '`') {
+			i++;
+			while (i < len && src[i] != c) {
+				if (src[i] == '\\' && c != '`' && !p_no_backslash_escapes) i++;
+				i++;
+			}
+			if (i >= len) return false;
+			// A doubled quote closes and reopens the string
+			i++;
+		} else if (c == '#' || (c == '-' && i + 2 < len && src[i + 1] == '-' && src[i + 2] <= ' ')) {
+			while (i < len && src[i] != '\n') i++;
+		} else if (c == '/' && i + 1 < len && src[i + 1] == '*') {
+			i += 2;
+			while (i + 1 < len && !(src[i] == '*' && src[i + 1] == '/')) i++;
+			if (i + 1 >= len) return false;
+			i += 2;
+		} else {
+			if (c == '?') r_placeholders.push_back(i);
+			i++;
+		}
+	}
+	return true;
+}
+
+Error MariaDBQueryTemplate::append_sql(const Array &p_params,
+		const bool p_no_backslash_escapes,
+		PackedByteArray &r_buf) const {
+	const PackedInt64Array &placeholders = p_no_backslash_escapes ? _placeholders_nbe : _placeholders;
+	ERR_FAIL_COND_V_MSG(!(p_no_backslash_escapes ? _valid_nbe : _valid), ERR_INVALID_DATA,
+			"Query template has no valid SQL for the server sql_mode.");
+	ERR_FAIL_COND_V_MSG(p_params.size() != placeholders.size(),
+			ERR_INVALID_PARAMETER,
+			vformat("Query template expects %d params, received %d.", placeholders.size(), p_params.size()));
+
+	const uint8_t *src = _sql_utf8.ptr();
+	int64_t frag_start = 0;
+	for (int64_t p = 0; p <= placeholders.size(); ++p) {
+		const int64_t frag_end = p < placeholders.size() ? placeholders[p] : _sql_utf8.size();
+		const int64_t frag_len = frag_end - frag_start;
+		if (frag_len > 0) {
+			const int64_t offset = r_buf.size();
+			r_buf.resize(offset + frag_len);
+			memcpy(r_buf.ptrw() + offset, src + frag_start, frag_len);
+		}
+		if (p == placeholders.size()) break;
+
+		Error err = _append_value(p_params[p], r_buf);
+		if (err != OK) {
+			ERR_PRINT(vformat("Query template param %d has unsupported type %s.",
+					p,
+					Variant::get_type_name(p_params[p].get_type())));
+			return err;
+		}
+		frag_start = frag_end + 1;
+	}
+	return OK;
+}
+
+String MariaDBQueryTemplate::render(const Array &p_params, const bool p_no_backslash_escapes) const {
+	PackedByteArray buf;
+	if (append_sql(p_params, p_no_backslash_escapes, buf) != OK) return String();
+	return buf.get_string_from_utf8();
+}
+
+Error MariaDBQueryTemplate::_append_value(const Variant &p_value, PackedByteArray &r_buf) {
+	char num[32];
+	int num_len = 0;
+
+	switch (p_value.get_type()) {
+		case Variant::NIL:
+			num_len = snprintf(num, sizeof(num), "NULL");
+			break;
+		case Variant::BOOL:
+			num_len = snprintf(num, sizeof(num), "%d", bool(p_value) ? 1 : 0);
+			break;
+		case Variant::INT:
+			num_len = snprintf(num, sizeof(num), "%lld", (long long)int64_t(p_value));
+			break;
+		case Variant::FLOAT: {
+			double d = p_value;
+			if (!std::isfinite(d)) return ERR_INVALID_PARAMETER;
+			// 17 significant digits round trips a double
+			num_len = snprintf(num, sizeof(num), "%.17g", d);
+			break;
+		}
+		case Variant::STRING:
+		case Variant::STRING_NAME: {
+			CharString utf8 = String(p_value).utf8();
+			_append_escaped(utf8.get_data(), utf8.length(), r_buf);
+			return OK;
+		}
+		case Variant::PACKED_BYTE_ARRAY: {
+			// X'hex' literal, binary safe regardless of the connection charset
+			PackedByteArray bytes = p_value;
+			_append_hex(bytes.ptr(), bytes.size(), "", r_buf);
+			return OK;
+		}
+		default:
+			return ERR_INVALID_PARAMETER;
+	}
+
+	const int64_t offset = r_buf.size();
+	r_buf.resize(offset + num_len);
+	memcpy(r_buf.ptrw() + offset, num, num_len);
+	return OK;
+}
+
+void MariaDBQueryTemplate::_append_hex(const uint8_t *p_src,
+		const int64_t p_len,
+		const char *p_introducer,
+		PackedByteArray &r_buf) {
+	static const char hex[] = "0123456789ABCDEF";
+	const int64_t intro_len = strlen(p_introducer);
+	const int64_t offset = r_buf.size();
+	r_buf.resize(offset + intro_len + p_len * 2 + 3);
+	uint8_t *dst = r_buf.ptrw() + offset;
+	memcpy(dst, p_introducer, intro_len);
+	dst += intro_len;
+	*dst++ = 'X';
+	*dst++ = '\'';
+	for (int64_t i = 0; i < p_len; ++i) {
+		*dst++ = hex[p_src[i] >> 4];
+		*dst++ = hex[p_src[i] & 0x0F];
+	}
+	*dst = '\'';
+}
+
+void MariaDBQueryTemplate::_append_escaped(const char *p_src, const int64_t p_len, PackedByteArray &r_buf) {
+	// A backslash reads differently with and without NO_BACKSLASH_ESCAPES, so a value holding one, or a byte that
+	// would need a backslash escape, goes as a hex literal. The output then does not depend on the sql_mode.
+	for (int64_t i = 0; i < p_len; ++i) {
+		if (p_src[i] == '\\' || p_src[i] == '\0' || p_src[i] == '\x1a') {
+			_append_hex(reinterpret_cast<const uint8_t *>(p_src), p_len, "_utf8mb4 ", r_buf);
+			return;
+		}
+	}
+
+	// Worst case every byte is a quote, plus the enclosing quotes, then shrink to what was written
+	const int64_t offset = r_buf.size();
+	r_buf.resize(offset + p_len * 2 + 2);
+	uint8_t *start = r_buf.ptrw() + offset;
+	uint8_t *dst = start;
+
+	*dst++ = '\'';
+	for (int64_t i = 0; i < p_len; ++i) {
+		// A doubled quote is a literal quote in both modes
+		if (p_src[i] == '\'') *dst++ = '\'';
+		*dst++ = p_src[i];
+	}
+	*dst++ = '\'';
+
+	r_buf.resize(offset + (dst - start));
+}
@@ -0,0 +1,88 @@
+/*************************************************************************/
+/*  mariadb_query_template.hpp                                           */
+/*************************************************************************/
+/*                     This file is part of the                          */
+/*                      MariaDBConnector addon                           */
+/*                    for use in the Godot Engine                        */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2021-2025 Shawn Shipton. https://vikingtinkerer.com     */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+#pragma once
+
+#include <godot_cpp/classes/ref_counted.hpp>
+#include <godot_cpp/core/class_db.hpp>
+#include <godot_cpp/variant/packed_byte_array.hpp>
+#include <godot_cpp/variant/packed_int64_array.hpp>
+
+using namespace godot;
+
+/**
+ * \brief		SQL with ? placeholders parsed once, the literal fragments are kept as UTF-8 and escaped values
+ *				are spliced between them directly into the COM_QUERY packet.
+ */
+class MariaDBQueryTemplate : public RefCounted {
+	GDCLASS(MariaDBQueryTemplate, RefCounted);
+
+public:
+	void set_sql(const String &p_sql);
+	String get_sql() const { return _sql; }
+	/**
+	 * \brief		Quoted strings in the SQL are read differently under NO_BACKSLASH_ESCAPES, both splits are kept.
+	 */
+	int get_param_count(const bool p_no_backslash_escapes = false) const {
+		return p_no_backslash_escapes ? _placeholders_nbe.size() : _placeholders.size();
+	}
+	bool is_valid(const bool p_no_backslash_escapes = false) const {
+		return p_no_backslash_escapes ? _valid_nbe : _valid;
+	}
+
+	/**
+	 * \brief		Appends the SQL with the params interpolated to r_buf.
+	 * \param		no_backslash_escapes	Server has NO_BACKSLASH_ESCAPES in sql_mode, picks how the SQL is split.
+	 */
+	Error append_sql(const Array &p_params, const bool p_no_backslash_escapes, PackedByteArray &r_buf) const;
+	String render(const Array &p_params, const bool p_no_backslash_escapes = false) const;
+
+protected:
+	static void _bind_methods();
+
+private:
+	String _sql;
+	PackedByteArray _sql_utf8;
+	// Byte offset of each ? in _sql_utf8, the fragments are the bytes between them
+	PackedInt64Array _placeholders;
+	// Same split with \ not escaping quotes, used when the server has NO_BACKSLASH_ESCAPES
+	PackedInt64Array _placeholders_nbe;
+	bool _valid = false;
+	bool _valid_nbe = false;
+
+	bool _parse(const bool p_no_backslash_escapes, PackedInt64Array &r_placeholders) const;
+
+	static Error _append_value(const Variant &p_value, PackedByteArray &r_buf);
+	static void _append_hex(const uint8_t *p_src,
+			const int64_t p_len,
+			const char *p_introducer,
+			PackedByteArray &r_buf);
+	static void _append_escaped(const char *p_src, const int64_t p_len, PackedByteArray &r_buf);
+};
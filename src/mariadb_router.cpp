@@ -0,0 +1,325 @@
+/*************************************************************************/
+/*  mariadb_router.cpp                                                   */
+/*************************************************************************/
+/*                     This file is part of the                          */
+/*                      MariaDBConnector addon                           */
+/*                    for use in the Godot Engine                        */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2021-2025 Shawn Shipton. https://vikingtinkerer.com     */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+#include "mariadb_router.hpp"
+
+#include <godot_cpp/classes/time.hpp>
+#include <godot_cpp/core/error_macros.hpp>
+
+namespace {
+
+// Found anywhere in the upper cased SQL these keep a read on the primary, a match inside a string literal only
+// costs a read on the primary.
+const char *const kPrimaryOnlyTokens[] = {
+	" FOR UPDATE",
+	" FOR SHARE",
+	"LOCK IN SHARE MODE",
+	" INTO ",
+	"@",
+	"GET_LOCK",
+	"RELEASE_LOCK",
+	"IS_USED_LOCK",
+	"IS_FREE_LOCK",
+	"LAST_INSERT_ID",
+	"FOUND_ROWS",
+	"ROW_COUNT",
+	"NEXTVAL",
+	"SETVAL",
+	"LASTVAL",
+	"NEXT VALUE FOR",
+	"PREVIOUS VALUE FOR",
+	"MASTER_POS_WAIT",
+	"MASTER_GTID_WAIT",
+};
+
+// Runs of spaces, tabs and newlines become a single space so multi word tokens match however the SQL is laid out
+String collapse_space(const String &p_sql) {
+	const int len = p_sql.length();
+	String collapsed;
+	collapsed.resize(len + 1);
+	const char32_t *src = p_sql.ptr();
+	char32_t *dst = collapsed.ptrw();
+	int n = 0;
+	for (int i = 0; i < len; i++) {
+		if (src[i] > ' ') {
+			dst[n++] = src[i];
+		} else if (n == 0 || dst[n - 1] != ' ') {
+			dst[n++] = ' ';
+		}
+	}
+	dst[n] = 0;
+	collapsed.resize(n + 1);
+	return collapsed;
+}
+
+int skip_space_and_comments(const String &p_sql, int p_pos) {
+	const int len = p_sql.length();
+	while (p_pos < len) {
+		const char32_t c = p_sql[p_pos];
+		if (c <= ' ' || c == '(') {
+			p_pos++;
+		} else if (c == '#' || (c == '-' && p_pos + 2 < len && p_sql[p_pos + 1] == '-' && p_sql[p_pos + 2] <= ' ')) {
+			while (p_pos < len && p_sql[p_pos] != '\n') p_pos++;
+		} else if (c == '/' && p_pos + 1 < len && p_sql[p_pos + 1] == '*') {
+			// Executable comments, /*! and /*M!, run their content
+			if (p_pos + 2 < len && (p_sql[p_pos + 2] == '!' || p_sql[p_pos + 2] == 'M')) return -1;
+			const int end = p_sql.find("*/", p_pos + 2);
+			if (end < 0) return -1;
+			p_pos = end + 2;
+		} else {
+			break;
+		}
+	}
+	return p_pos;
+}
+
+}  // namespace
+
+void MariaDBRouter::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("set_primary", "context"), &MariaDBRouter::set_primary);
+	ClassDB::bind_method(D_METHOD("get_primary"), &MariaDBRouter::get_primary);
+	ClassDB::bind_method(D_METHOD("add_replica", "context", "weight"), &MariaDBRouter::add_replica, DEFVAL(1));
+	ClassDB::bind_method(D_METHOD("clear_replicas"), &MariaDBRouter::clear_replicas);
+	ClassDB::bind_method(D_METHOD("get_replica_count"), &MariaDBRouter::get_replica_count);
+	ClassDB::bind_method(D_METHOD("get_replica_status"), &MariaDBRouter::get_replica_status);
+	ClassDB::bind_method(D_METHOD("set_max_replica_lag", "sec"), &MariaDBRouter::set_max_replica_lag);
+	ClassDB::bind_method(D_METHOD("get_max_replica_lag"), &MariaDBRouter::get_max_replica_lag);
+	ClassDB::bind_method(D_METHOD("set_health_check_interval", "msec"), &MariaDBRouter::set_health_check_interval);
+	ClassDB::bind_method(D_METHOD("get_health_check_interval"), &MariaDBRouter::get_health_check_interval);
+	ClassDB::bind_method(D_METHOD("set_causal_reads", "enable", "wait_msec"),
+			&MariaDBRouter::set_causal_reads,
+			DEFVAL(50));
+	ClassDB::bind_method(D_METHOD("is_causal_reads"), &MariaDBRouter::is_causal_reads);
+	ClassDB::bind_method(D_METHOD("get_session_gtid"), &MariaDBRouter::get_session_gtid);
+	ClassDB::bind_method(D_METHOD("set_session_gtid", "gtid"), &MariaDBRouter::set_session_gtid);
+	ClassDB::bind_method(D_METHOD("select_query", "sql_stmt"), &MariaDBRouter::select_query);
+	ClassDB::bind_method(D_METHOD("query", "sql_stmt"), &MariaDBRouter::query);
+	ClassDB::bind_method(D_METHOD("get_last_error"), &MariaDBRouter::get_last_error);
+	ClassDB::bind_method(D_METHOD("get_route_stats"), &MariaDBRouter::get_route_stats);
+	ClassDB::bind_static_method(
+			"MariaDBRouter", D_METHOD("is_replica_safe", "sql_stmt"), &MariaDBRouter::is_replica_safe);
+
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "max_replica_lag"), "set_max_replica_lag", "get_max_replica_lag");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "health_check_interval"),
+			"set_health_check_interval",
+			"get_health_check_interval");
+}
+
+MariaDBConnector::ErrorCode MariaDBRouter::set_primary(const Ref<MariaDBConnectContext> &p_context) {
+	ERR_FAIL_COND_V_MSG(p_context.is_null(), MariaDBConnector::ERR_INIT_ERROR, "ConnectionContext is null.");
+
+	if (_primary.is_valid()) _primary->disconnect_db();
+	_primary.instantiate();
+	_primary->set_track_gtid(_causal_reads);
+	_primary_gtid = String();
+	_last_error = _primary->connect_db_ctx(p_context);
+	return _last_error;
+}
+
+void MariaDBRouter::set_causal_reads(const bool p_enable, const int p_wait_msec) {
+	_causal_reads = p_enable;
+	_causal_wait_msec = MAX(p_wait_msec, 0);
+	if (_primary.is_valid()) _primary->set_track_gtid(p_enable);
+}
+
+void MariaDBRouter::set_session_gtid(const String &p_gtid) {
+	// Spliced into MASTER_GTID_WAIT, a GTID list is domain-server-sequence triplets separated by commas
+	for (int i = 0; i < p_gtid.length(); i++) {
+		const char32_t c = p_gtid[i];
+		ERR_FAIL_COND_MSG(!((c >= '0' && c <= '9') || c == '-' || c == ','), vformat("Invalid GTID: %s", p_gtid));
+	}
+	_session_gtid = p_gtid;
+}
+
+void MariaDBRouter::add_replica(const Ref<MariaDBConnectContext> &p_context, const int p_weight) {
+	ERR_FAIL_COND_MSG(p_context.is_null(), "ConnectionContext is null.");
+	ERR_FAIL_COND_MSG(p_weight <= 0, "Replica weight must be positive.");
+
+	// Connected and checked by the first read routed after it was added
+	Replica replica;
+	replica.context = p_context;
+	replica.weight = p_weight;
+	_replicas.push_back(replica);
+}
+
+void MariaDBRouter::clear_replicas() {
+	for (Replica &replica : _replicas) {
+		if (replica.conn.is_valid()) replica.conn->disconnect_db();
+	}
+	_replicas.clear();
+}
+
+TypedArray<Dictionary> MariaDBRouter::get_replica_status() const {
+	TypedArray<Dictionary> status;
+	for (const Replica &replica : _replicas) {
+		Dictionary entry;
+		entry["hostname"] = replica.context->get_hostname();
+		entry["weight"] = replica.weight;
+		entry["lag_sec"] = replica.lag_sec;
+		entry["healthy"] = replica.healthy;
+		status.push_back(entry);
+	}
+	return status;
+}
+
+Dictionary MariaDBRouter::get_route_stats() const {
+	Dictionary stats;
+	stats["primary"] = _primary_cnt;
+	stats["replica"] = _replica_cnt;
+	stats["fallback"] = _fallback_cnt;
+	stats["causal_fallback"] = _causal_fallback_cnt;
+	return stats;
+}
+
+bool MariaDBRouter::is_replica_safe(const String &p_sql) {
+	const int start = skip_space_and_comments(p_sql, 0);
+	if (start < 0) return false;
+
+	const String sql = collapse_space(p_sql.substr(start).strip_edges().trim_suffix(";").to_upper());
+	int word_end = 0;
+	while (word_end < sql.length() && sql[word_end] >= 'A' && sql[word_end] <= 'Z') word_end++;
+	const String keyword = sql.substr(0, word_end);
+	if (keyword != "SELECT" && keyword != "WITH") return false;
+	// Multi-statements may hide a write behind the SELECT
+	if (sql.contains(";")) return false;
+
+	for (const char *token : kPrimaryOnlyTokens) {
+		if (sql.contains(token)) return false;
+	}
+	return true;
+}
+
+TypedArray<Dictionary> MariaDBRouter::select_query(const String &p_sql) {
+	return TypedArray<Dictionary>(Array(_route(p_sql, true)));
+}
+
+Variant MariaDBRouter::query(const String &p_sql) { return _route(p_sql, false); }
+
+Variant MariaDBRouter::_route(const String &p_sql, const bool p_select) {
+	if (_primary.is_null()) {
+		_last_error = MariaDBConnector::ERR_NOT_CONNECTED;
+		ERR_PRINT("Router has no primary, call set_primary first.");
+		return p_select ? Variant(Array()) : Variant(_last_error);
+	}
+
+	const auto run_on = [&](const Ref<MariaDBConnector> &p_conn) -> Variant {
+		Variant result = p_select ? Variant(p_conn->select_query(p_sql)) : p_conn->query(p_sql);
+		_last_error = p_conn->get_last_error();
+		return result;
+	};
+
+	// An open transaction, or autocommit off, must see its own writes so it stays on the primary
+	if (!_replicas.empty() && !_primary->is_in_transaction() && is_replica_safe(p_sql)) {
+		const int idx = _pick_replica();
+		if (idx >= 0 && !_replica_caught_up(_replicas[idx])) {
+			_causal_fallback_cnt++;
+		} else if (idx >= 0) {
+			Replica &replica = _replicas[idx];
+			Variant result = run_on(replica.conn);
+			if (replica.conn->is_connected_db()) {
+				_replica_cnt++;
+				return result;
+			}
+			// Lost mid-read, evicted until the next check reconnects it
+			replica.healthy = false;
+			replica.lag_sec = -1;
+			replica.next_check_msec = Time::get_singleton()->get_ticks_msec() + _check_interval_msec;
+			_fallback_cnt++;
+		}
+	}
+
+	_primary_cnt++;
+	Variant result = run_on(_primary);
+	if (_causal_reads) {
+		const String gtid = _primary->get_last_gtid();
+		if (gtid != _primary_gtid) {
+			_primary_gtid = gtid;
+			_session_gtid = gtid;
+		}
+	}
+	return result;
+}
+
+bool MariaDBRouter::_replica_caught_up(Replica &r_replica) {
+	if (!_causal_reads || _session_gtid.is_empty() || r_replica.synced_gtid == _session_gtid) return true;
+
+	// 0 once applied, -1 on timeout, a timeout of 0 only checks
+	const String sql = vformat("SELECT MASTER_GTID_WAIT('%s', %.3f) AS w", _session_gtid, _causal_wait_msec / 1000.0);
+	const TypedArray<Dictionary> rows = r_replica.conn->select_query(sql);
+	if (rows.is_empty() || (int)Dictionary(rows[0]).get("w", -1) != 0) return false;
+
+	r_replica.synced_gtid = _session_gtid;
+	return true;
+}
+
+int MariaDBRouter::_pick_replica() {
+	const uint64_t now_msec = Time::get_singleton()->get_ticks_msec();
+	int total_weight = 0;
+	int best = -1;
+	for (size_t i = 0; i < _replicas.size(); i++) {
+		Replica &replica = _replicas[i];
+		if (now_msec >= replica.next_check_msec) _check_replica(replica, now_msec);
+		if (!replica.healthy) continue;
+
+		replica.current_weight += replica.weight;
+		total_weight += replica.weight;
+		if (best < 0 || replica.current_weight > _replicas[best].current_weight) best = (int)i;
+	}
+
+	if (best >= 0) _replicas[best].current_weight -= total_weight;
+	return best;
+}
+
+void MariaDBRouter::_check_replica(Replica &r_replica, const uint64_t p_now_msec) {
+	r_replica.next_check_msec = p_now_msec + _check_interval_msec;
+	r_replica.healthy = false;
+	r_replica.lag_sec = -1;
+
+	if (r_replica.conn.is_null()) r_replica.conn.instantiate();
+	if (!r_replica.conn->is_connected_db()) {
+		if (r_replica.conn->connect_db_ctx(r_replica.context) != MariaDBConnector::OK) return;
+	}
+
+	// One row per replication source, a server that replicates from nothing has no lag
+	const TypedArray<Dictionary> sources = r_replica.conn->select_query("SHOW ALL SLAVES STATUS");
+	if (r_replica.conn->get_last_error() != MariaDBConnector::OK) return;
+
+	int lag_sec = 0;
+	for (int i = 0; i < sources.size(); i++) {
+		const Dictionary source = sources[i];
+		const Variant behind = source.get("Seconds_Behind_Master", Variant());
+		// NULL while the SQL or IO thread is stopped
+		if (behind.get_type() == Variant::NIL) return;
+		lag_sec = MAX(lag_sec, (int)behind);
+	}
+
+	r_replica.lag_sec = lag_sec;
+	r_replica.healthy = lag_sec <= _max_lag_sec;
+}
@@ -0,0 +1,135 @@
+/*************************************************************************/
+/*  mariadb_router.hpp                                                   */
+/*************************************************************************/
+/*                     This file is part of the                          */
+/*                      MariaDBConnector addon                           */
+/*                    for use in the Godot Engine                        */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2021-2025 Shawn Shipton. https://vikingtinkerer.com     */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+#pragma once
+
+#include "mariadb_connect_context.hpp"
+#include "mariadb_connector.hpp"
+
+#include <godot_cpp/classes/ref_counted.hpp>
+#include <godot_cpp/core/class_db.hpp>
+
+#include <vector>
+
+using namespace godot;
+
+/**
+ * \brief		Read/write splitting over a primary and weighted read replicas. Reads outside of a transaction go to
+ *				a healthy replica by smooth weighted round robin, everything else to the primary. Replicas are
+ *				checked for replication lag on an interval from the routing call and evicted while they lag or
+ *				are unreachable. Like MariaDBConnector it is used from one thread at a time.
+ */
+class MariaDBRouter : public RefCounted {
+	GDCLASS(MariaDBRouter, RefCounted);
+
+public:
+	MariaDBConnector::ErrorCode set_primary(const Ref<MariaDBConnectContext> &p_context);
+	Ref<MariaDBConnector> get_primary() const { return _primary; }
+	void add_replica(const Ref<MariaDBConnectContext> &p_context, const int p_weight = 1);
+	void clear_replicas();
+	int get_replica_count() const { return (int)_replicas.size(); }
+	/**
+	 * \brief		One Dictionary per replica with "hostname", "weight", "lag_sec", -1 while unknown or replication
+	 *				is stopped, and "healthy".
+	 */
+	TypedArray<Dictionary> get_replica_status() const;
+
+	void set_max_replica_lag(const int p_sec) { _max_lag_sec = MAX(p_sec, 0); }
+	int get_max_replica_lag() const { return _max_lag_sec; }
+	void set_health_check_interval(const int p_msec) { _check_interval_msec = MAX(p_msec, 1); }
+	int get_health_check_interval() const { return _check_interval_msec; }
+
+	/**
+	 * \brief		Read-your-writes on replicas. The primary tracks the GTID of each committed write, a replica read
+	 *				after a write first waits up to wait_msec with MASTER_GTID_WAIT for the replica to apply it and
+	 *				runs on the primary if it has not.
+	 */
+	void set_causal_reads(const bool p_enable, const int p_wait_msec = 50);
+	bool is_causal_reads() const { return _causal_reads; }
+	/**
+	 * \brief		GTID the next replica read must see, carried between routers to keep a player's session causal.
+	 */
+	String get_session_gtid() const { return _session_gtid; }
+	void set_session_gtid(const String &p_gtid);
+
+	TypedArray<Dictionary> select_query(const String &p_sql);
+	Variant query(const String &p_sql);
+	MariaDBConnector::ErrorCode get_last_error() const { return _last_error; }
+	/**
+	 * \brief		Routed call counts, "primary", "replica", "fallback" for replica reads retried on the primary
+	 *				after the replica connection was lost and "causal_fallback" for reads sent to the primary
+	 *				because no replica caught up with the session GTID in time.
+	 */
+	Dictionary get_route_stats() const;
+
+	/**
+	 * \brief		Conservative classification, a single SELECT or WITH statement without locking reads, INTO,
+	 *				user variables or session dependent functions. Anything else is sent to the primary.
+	 */
+	static bool is_replica_safe(const String &p_sql);
+
+protected:
+	static void _bind_methods();
+
+private:
+	struct Replica {
+		Ref<MariaDBConnectContext> context;
+		Ref<MariaDBConnector> conn;
+		int weight = 1;
+		// Smooth weighted round robin state
+		int current_weight = 0;
+		int lag_sec = -1;
+		bool healthy = false;
+		uint64_t next_check_msec = 0;
+		// Session GTID this replica is known to have applied, no wait needed until the next write
+		String synced_gtid;
+	};
+
+	Ref<MariaDBConnector> _primary;
+	std::vector<Replica> _replicas;
+	int _max_lag_sec = 10;
+	int _check_interval_msec = 5000;
+	MariaDBConnector::ErrorCode _last_error = MariaDBConnector::OK;
+	uint64_t _primary_cnt = 0;
+	uint64_t _replica_cnt = 0;
+	uint64_t _fallback_cnt = 0;
+	uint64_t _causal_fallback_cnt = 0;
+
+	bool _causal_reads = false;
+	int _causal_wait_msec = 50;
+	String _session_gtid;
+	// Last GTID taken from the primary, a new one advances the session GTID
+	String _primary_gtid;
+
+	void _check_replica(Replica &r_replica, const uint64_t p_now_msec);
+	int _pick_replica();
+	bool _replica_caught_up(Replica &r_replica);
+	Variant _route(const String &p_sql, const bool p_select);
+};
@@ -0,0 +1,267 @@
+/*************************************************************************/
+/*  mariadb_shard_map.cpp                                                */
+/*************************************************************************/
+/*                     This file is part of the                          */
+/*                      MariaDBConnector addon                           */
+/*                    for use in the Godot Engine                        */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2021-2025 Shawn Shipton. https://vikingtinkerer.com     */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+#include "mariadb_shard_map.hpp"
+
+#include <godot_cpp/classes/worker_thread_pool.hpp>
+#include <godot_cpp/core/error_macros.hpp>
+
+#include <algorithm>
+
+void MariaDBShardMap::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("set_mode", "mode"), &MariaDBShardMap::set_mode);
+	ClassDB::bind_method(D_METHOD("get_mode"), &MariaDBShardMap::get_mode);
+	ClassDB::bind_method(D_METHOD("set_virtual_nodes", "count"), &MariaDBShardMap::set_virtual_nodes);
+	ClassDB::bind_method(D_METHOD("get_virtual_nodes"), &MariaDBShardMap::get_virtual_nodes);
+	ClassDB::bind_method(D_METHOD("add_shard", "name", "target", "weight"), &MariaDBShardMap::add_shard, DEFVAL(1));
+	ClassDB::bind_method(D_METHOD("remove_shard", "name"), &MariaDBShardMap::remove_shard);
+	ClassDB::bind_method(D_METHOD("get_shard_names"), &MariaDBShardMap::get_shard_names);
+	ClassDB::bind_method(D_METHOD("add_range", "lower_bound", "name"), &MariaDBShardMap::add_range);
+	ClassDB::bind_method(D_METHOD("clear_ranges"), &MariaDBShardMap::clear_ranges);
+	ClassDB::bind_method(D_METHOD("get_hash_ranges"), &MariaDBShardMap::get_hash_ranges);
+	ClassDB::bind_static_method("MariaDBShardMap", D_METHOD("hash_key", "key"), &MariaDBShardMap::hash_key);
+	ClassDB::bind_method(D_METHOD("get_shard_name", "key"), &MariaDBShardMap::get_shard_name);
+	ClassDB::bind_method(D_METHOD("get_connection", "key"), &MariaDBShardMap::get_connection);
+	ClassDB::bind_method(D_METHOD("select_query", "key", "sql_stmt"), &MariaDBShardMap::select_query);
+	ClassDB::bind_method(D_METHOD("query", "key", "sql_stmt"), &MariaDBShardMap::query);
+	ClassDB::bind_method(D_METHOD("scatter_select", "sql_stmt"), &MariaDBShardMap::scatter_select);
+	ClassDB::bind_method(D_METHOD("get_last_error"), &MariaDBShardMap::get_last_error);
+
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "mode", PROPERTY_HINT_ENUM, "Hash,Range"), "set_mode", "get_mode");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "virtual_nodes"), "set_virtual_nodes", "get_virtual_nodes");
+
+	BIND_ENUM_CONSTANT(SHARD_MODE_HASH);
+	BIND_ENUM_CONSTANT(SHARD_MODE_RANGE);
+}
+
+uint64_t MariaDBShardMap::_hash(const String &p_str) {
+	// FNV-1a over the UTF-8 bytes, stable across platforms and runs so the ring is too
+	const CharString utf8 = p_str.utf8();
+	uint64_t hash = 14695981039346656037ULL;
+	for (int i = 0; i < utf8.length(); i++) {
+		hash ^= (uint8_t)utf8[i];
+		hash *= 1099511628211ULL;
+	}
+	// FNV alone leaves similar names clustered, the finalizer spreads them over the ring
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdULL;
+	hash ^= hash >> 33;
+	return hash;
+}
+
+void MariaDBShardMap::set_virtual_nodes(const int p_count) {
+	ERR_FAIL_COND_MSG(p_count <= 0, "Virtual node count must be positive.");
+	_virtual_nodes = p_count;
+	_rebuild_ring();
+}
+
+void MariaDBShardMap::add_shard(const String &p_name, const Ref<RefCounted> &p_target, const int p_weight) {
+	ERR_FAIL_COND_MSG(p_name.is_empty(), "Shard name is empty.");
+	ERR_FAIL_COND_MSG(_find_shard(p_name) >= 0, vformat("Shard %s already exists.", p_name));
+	ERR_FAIL_COND_MSG(p_weight <= 0, "Shard weight must be positive.");
+
+	Shard shard;
+	shard.name = p_name;
+	shard.weight = p_weight;
+	shard.context = p_target;
+	shard.router = p_target;
+	ERR_FAIL_COND_MSG(shard.context.is_null() && shard.router.is_null(),
+			"Shard target must be a MariaDBConnectContext or a MariaDBRouter.");
+
+	_shards.push_back(shard);
+	_rebuild_ring();
+}
+
+void MariaDBShardMap::remove_shard(const String &p_name) {
+	const int idx = _find_shard(p_name);
+	ERR_FAIL_COND_MSG(idx < 0, vformat("Shard %s does not exist.", p_name));
+
+	if (_shards[idx].conn.is_valid()) _shards[idx].conn->disconnect_db();
+	_shards.erase(_shards.begin() + idx);
+	_rebuild_ring();
+}
+
+PackedStringArray MariaDBShardMap::get_shard_names() const {
+	PackedStringArray names;
+	for (const Shard &shard : _shards) names.push_back(shard.name);
+	return names;
+}
+
+void MariaDBShardMap::add_range(const int64_t p_lower_bound, const String &p_name) {
+	const auto it = std::lower_bound(_ranges.begin(), _ranges.end(), std::make_pair(p_lower_bound, String()),
+			[](const std::pair<int64_t, String> &a, const std::pair<int64_t, String> &b) { return a.first < b.first; });
+	// Reassigning a bound moves only that range
+	if (it != _ranges.end() && it->first == p_lower_bound) {
+		it->second = p_name;
+	} else {
+		_ranges.insert(it, std::make_pair(p_lower_bound, p_name));
+	}
+}
+
+TypedArray<Dictionary> MariaDBShardMap::get_hash_ranges() const {
+	TypedArray<Dictionary> ranges;
+	for (size_t i = 0; i < _ring.size(); i++) {
+		// Each position owns the hashes after its predecessor, the first one wraps around
+		Dictionary range;
+		range["start"] = (int64_t)(i == 0 ? _ring.back().first + 1 : _ring[i - 1].first + 1);
+		range["end"] = (int64_t)_ring[i].first;
+		range["shard"] = _shards[_ring[i].second].name;
+		ranges.push_back(range);
+	}
+	return ranges;
+}
+
+void MariaDBShardMap::_rebuild_ring() {
+	_ring.clear();
+	for (size_t i = 0; i < _shards.size(); i++) {
+		const int vnodes = _virtual_nodes * _shards[i].weight;
+		for (int v = 0; v < vnodes; v++) {
+			_ring.push_back(std::make_pair(_hash(_shards[i].name + "#" + itos(v)), (int)i));
+		}
+	}
+	std::sort(_ring.begin(), _ring.end());
+}
+
+int MariaDBShardMap::_find_shard(const String &p_name) const {
+	for (size_t i = 0; i < _shards.size(); i++) {
+		if (_shards[i].name == p_name) return (int)i;
+	}
+	return -1;
+}
+
+int MariaDBShardMap::_shard_index(const Variant &p_key) const {
+	if (_mode == SHARD_MODE_RANGE) {
+		ERR_FAIL_COND_V_MSG(p_key.get_type() != Variant::INT, -1, "Range sharding needs an int key.");
+		const int64_t key = p_key;
+		const auto it = std::upper_bound(_ranges.begin(), _ranges.end(), key,
+				[](const int64_t k, const std::pair<int64_t, String> &range) { return k < range.first; });
+		ERR_FAIL_COND_V_MSG(it == _ranges.begin(), -1, vformat("No range covers key %d.", key));
+		return _find_shard((it - 1)->second);
+	}
+
+	ERR_FAIL_COND_V_MSG(_ring.empty(), -1, "Shard map has no shards.");
+	const uint64_t hash = _hash(p_key.stringify());
+	auto it = std::lower_bound(_ring.begin(), _ring.end(), std::make_pair(hash, -1));
+	if (it == _ring.end()) it = _ring.begin();
+	return it->second;
+}
+
+String MariaDBShardMap::get_shard_name(const Variant &p_key) const {
+	const int idx = _shard_index(p_key);
+	return idx < 0 ? String() : _shards[idx].name;
+}
+
+Variant MariaDBShardMap::_run(Shard &r_shard,
+		const String &p_sql,
+		const bool p_select,
+		MariaDBConnector::ErrorCode &r_error) {
+	Variant result;
+	if (r_shard.router.is_valid()) {
+		result = p_select ? Variant(r_shard.router->select_query(p_sql)) : r_shard.router->query(p_sql);
+		r_error = r_shard.router->get_last_error();
+		return result;
+	}
+
+	if (r_shard.conn.is_null()) r_shard.conn.instantiate();
+	if (!r_shard.conn->is_connected_db()) {
+		r_error = r_shard.conn->connect_db_ctx(r_shard.context);
+		if (r_error != MariaDBConnector::OK) {
+			return p_select ? Variant(TypedArray<Dictionary>()) : Variant(r_error);
+		}
+	}
+	result = p_select ? Variant(r_shard.conn->select_query(p_sql)) : r_shard.conn->query(p_sql);
+	r_error = r_shard.conn->get_last_error();
+	return result;
+}
+
+Ref<MariaDBConnector> MariaDBShardMap::get_connection(const Variant &p_key) {
+	const int idx = _shard_index(p_key);
+	if (idx < 0) return Ref<MariaDBConnector>();
+
+	Shard &shard = _shards[idx];
+	if (shard.router.is_valid()) return shard.router->get_primary();
+	if (shard.conn.is_null()) shard.conn.instantiate();
+	if (!shard.conn->is_connected_db()) {
+		_last_error = shard.conn->connect_db_ctx(shard.context);
+		if (_last_error != MariaDBConnector::OK) return Ref<MariaDBConnector>();
+	}
+	return shard.conn;
+}
+
+TypedArray<Dictionary> MariaDBShardMap::select_query(const Variant &p_key, const String &p_sql) {
+	const int idx = _shard_index(p_key);
+	if (idx < 0) {
+		_last_error = MariaDBConnector::ERR_INVALID_PARAMETER;
+		return TypedArray<Dictionary>();
+	}
+	return TypedArray<Dictionary>(Array(_run(_shards[idx], p_sql, true, _last_error)));
+}
+
+Variant MariaDBShardMap::query(const Variant &p_key, const String &p_sql) {
+	const int idx = _shard_index(p_key);
+	if (idx < 0) {
+		_last_error = MariaDBConnector::ERR_INVALID_PARAMETER;
+		return _last_error;
+	}
+	return _run(_shards[idx], p_sql, false, _last_error);
+}
+
+void MariaDBShardMap::_scatter_task(void *p_userdata, uint32_t p_index) {
+	ScatterJob *job = static_cast<ScatterJob *>(p_userdata);
+	// Each task owns one shard and its connection, nothing else is shared
+	const Variant rows = job->map->_run(job->map->_shards[p_index], job->sql, true, job->errors[p_index]);
+	job->rows[p_index] = TypedArray<Dictionary>(Array(rows));
+}
+
+TypedArray<Dictionary> MariaDBShardMap::scatter_select(const String &p_sql) {
+	_last_error = MariaDBConnector::OK;
+	TypedArray<Dictionary> merged;
+	if (_shards.empty()) return merged;
+
+	ScatterJob job;
+	job.map = this;
+	job.sql = p_sql;
+	job.rows.resize(_shards.size());
+	job.errors.resize(_shards.size(), MariaDBConnector::OK);
+
+	WorkerThreadPool *pool = WorkerThreadPool::get_singleton();
+	const int64_t task_id = pool->add_native_group_task(
+			&MariaDBShardMap::_scatter_task, &job, (int)_shards.size(), (int)_shards.size(), true, "MariaDB scatter");
+	pool->wait_for_group_task_completion(task_id);
+
+	for (size_t i = 0; i < _shards.size(); i++) {
+		if (job.errors[i] != MariaDBConnector::OK && _last_error == MariaDBConnector::OK) {
+			_last_error = job.errors[i];
+			ERR_PRINT(vformat("Scatter select failed on shard %s, error %d.", _shards[i].name, (int)job.errors[i]));
+		}
+		merged.append_array(job.rows[i]);
+	}
+	return merged;
+}
@@ -0,0 +1,137 @@
+/*************************************************************************/
+/*  mariadb_shard_map.hpp                                                */
+/*************************************************************************/
+/*                     This file is part of the                          */
+/*                      MariaDBConnector addon                           */
+/*                    for use in the Godot Engine                        */
+/*                           GODOT ENGINE                                */
+/*                      https://godotengine.org                          */
+/*************************************************************************/
+/* Copyright (c) 2021-2025 Shawn Shipton. https://vikingtinkerer.com     */
+/*                                                                       */
+/* Permission is hereby granted, free of charge, to any person obtaining */
+/* a copy of this software and associated documentation files (the       */
+/* "Software"), to deal in the Software without restriction, including   */
+/* without limitation the rights to use, copy, modify, merge, publish,   */
+/* distribute, sublicense, and/or sell copies of the Software, and to    */
+/* permit persons to whom the Software is furnished to do so, subject to */
+/* the following conditions:                                             */
+/*                                                                       */
+/* The above copyright notice and this permission notice shall be        */
+/* included in all copies or substantial portions of the Software.       */
+/*                                                                       */
+/* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,       */
+/* EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF    */
+/* MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.*/
+/* IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY  */
+/* CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,  */
+/* TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE     */
+/* SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.                */
+/*************************************************************************/
+#pragma once
+
+#include "mariadb_connect_context.hpp"
+#include "mariadb_connector.hpp"
+#include "mariadb_router.hpp"
+
+#include <godot_cpp/classes/ref_counted.hpp>
+#include <godot_cpp/core/class_db.hpp>
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+using namespace godot;
+
+/**
+ * \brief		Routes queries by a shard key to one of several servers. Keys are placed on a consistent hash ring
+ *				of virtual nodes, or looked up in a table of integer key ranges. A shard is a MariaDBConnectContext,
+ *				connected on first use, or a MariaDBRouter with its own replicas. Cross-shard reads run on all
+ *				shards in parallel on the WorkerThreadPool.
+ */
+class MariaDBShardMap : public RefCounted {
+	GDCLASS(MariaDBShardMap, RefCounted);
+
+public:
+	enum ShardMode {
+		SHARD_MODE_HASH,
+		SHARD_MODE_RANGE,
+	};
+
+	void set_mode(const ShardMode p_mode) { _mode = p_mode; }
+	ShardMode get_mode() const { return _mode; }
+	void set_virtual_nodes(const int p_count);
+	int get_virtual_nodes() const { return _virtual_nodes; }
+
+	/**
+	 * \brief		Adds a shard, target is a MariaDBConnectContext or a MariaDBRouter. The ring positions derive
+	 *				from the name, keep names stable so adding or removing a shard only moves its own key ranges.
+	 */
+	void add_shard(const String &p_name, const Ref<RefCounted> &p_target, const int p_weight = 1);
+	void remove_shard(const String &p_name);
+	PackedStringArray get_shard_names() const;
+	/**
+	 * \brief		Range mode, keys from lower_bound up to the next bound go to the named shard.
+	 */
+	void add_range(const int64_t p_lower_bound, const String &p_name);
+	void clear_ranges() { _ranges.clear(); }
+	/**
+	 * \brief		Hash mode ring as Dictionaries of "start", "end" and "shard", end inclusive, for planning the
+	 *				data moved when the shards change.
+	 */
+	TypedArray<Dictionary> get_hash_ranges() const;
+	/**
+	 * \brief		Ring position of a key, as the bits of an unsigned 64-bit hash.
+	 */
+	static int64_t hash_key(const Variant &p_key) { return (int64_t)_hash(p_key.stringify()); }
+
+	String get_shard_name(const Variant &p_key) const;
+	/**
+	 * \brief		Connection of the key's shard, the primary when the shard is a MariaDBRouter.
+	 */
+	Ref<MariaDBConnector> get_connection(const Variant &p_key);
+	TypedArray<Dictionary> select_query(const Variant &p_key, const String &p_sql);
+	Variant query(const Variant &p_key, const String &p_sql);
+	/**
+	 * \brief		Runs the SELECT on every shard in parallel and returns the rows concatenated in shard order.
+	 */
+	TypedArray<Dictionary> scatter_select(const String &p_sql);
+	MariaDBConnector::ErrorCode get_last_error() const { return _last_error; }
+
+protected:
+	static void _bind_methods();
+
+private:
+	struct Shard {
+		String name;
+		Ref<MariaDBConnectContext> context;
+		Ref<MariaDBConnector> conn;
+		Ref<MariaDBRouter> router;
+		int weight = 1;
+	};
+
+	struct ScatterJob {
+		MariaDBShardMap *map = nullptr;
+		String sql;
+		std::vector<TypedArray<Dictionary>> rows;
+		std::vector<MariaDBConnector::ErrorCode> errors;
+	};
+
+	ShardMode _mode = SHARD_MODE_HASH;
+	int _virtual_nodes = 128;
+	std::vector<Shard> _shards;
+	// Sorted (position, shard index), rebuilt when the shards change
+	std::vector<std::pair<uint64_t, int>> _ring;
+	// Sorted (lower bound, shard name)
+	std::vector<std::pair<int64_t, String>> _ranges;
+	MariaDBConnector::ErrorCode _last_error = MariaDBConnector::OK;
+
+	static uint64_t _hash(const String &p_str);
+	void _rebuild_ring();
+	int _find_shard(const String &p_name) const;
+	int _shard_index(const Variant &p_key) const;
+	Variant _run(Shard &r_shard, const String &p_sql, const bool p_select, MariaDBConnector::ErrorCode &r_error);
+	static void _scatter_task(void *p_userdata, uint32_t p_index);
+};
+
+VARIANT_ENUM_CAST(MariaDBShardMap::ShardMode);
@@ -32,6 +32,11 @@
 #include "mariadb_connector.hpp"
 #include "argon2_hasher.hpp"
 #include "mariadb_connect_context.hpp"
+#include "mariadb_connection_pool.hpp"
+#include "mariadb_dns_cache.hpp"
+#include "mariadb_query_template.hpp"
+#include "mariadb_router.hpp"
+#include "mariadb_shard_map.hpp"
 
 #include <gdextension_interface.h>
 
@@ -45,6 +50,10 @@ void initialize_mariadb_connector(ModuleInitializationLevel p_level) {
 	GDREGISTER_CLASS(MariaDBConnector);
 	GDREGISTER_CLASS(Argon2Hasher);
 	GDREGISTER_CLASS(MariaDBConnectContext);
+	GDREGISTER_CLASS(MariaDBQueryTemplate);
+	GDREGISTER_CLASS(MariaDBRouter);
+	GDREGISTER_CLASS(MariaDBShardMap);
+	GDREGISTER_CLASS(MariaDBConnectionPool);
 }
 
 void uninitialize_mariadb_connector(ModuleInitializationLevel p_level) {
@@ -52,7 +61,8 @@ void uninitialize_mariadb_connector(ModuleInitializationLevel p_level) {
 		return;
 	}
 
-
+	// Cached Strings and queued resolver items must be released while the engine is still up
+	MariaDBDnsCache::clear();
 }
 
 extern "C"{